@@ -10,6 +10,7 @@ BuildRequires:  pkgconfig(QtCore) >= 4.6.0
 BuildRequires:  pkgconfig(QtOpenGL)
 BuildRequires:  pkgconfig(QtGui)
 BuildRequires:  pkgconfig(QJson)
+BuildRequires:  pkgconfig(xext)
 BuildRequires:  pkgconfig(libxul-embedding)
 BuildRequires:  pkgconfig(nspr)
 BuildRequires:  pkgconfig(QtTest)
@@ -50,6 +51,7 @@ qmake
 %files
 %defattr(-,root,root,-)
 %{_libdir}/*.so.*
+%{_datadir}/qtmozembed
 
 %files devel
 %defattr(-,root,root,-)
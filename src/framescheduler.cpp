@@ -0,0 +1,173 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#define LOG_COMPONENT "FrameScheduler"
+
+#include <stdlib.h>
+
+#include "framescheduler.h"
+#include "mozilla/embedlite/EmbedLog.h"
+
+static const int kDefaultFps = 60;
+static const int kDefaultBackgroundDivider = 6;
+// Vsync driven frames wait this long for vsync() before the timer issues
+// them, about three frames at 60 Hz
+static const int kVsyncTimeout = 50;
+
+FrameScheduler::FrameScheduler(QObject* parent)
+    : QObject(parent)
+    , mNextTick(-1)
+    , mTargetFps(kDefaultFps)
+    , mBackgroundDivider(kDefaultBackgroundDivider)
+    , mVsyncDriven(false)
+    , mScheduledFrames(0)
+    , mCoalescedFrames(0)
+    , mDroppedFrames(0)
+    , mThrottledFrames(0)
+{
+    mClock.start();
+    mTimer.setSingleShot(true);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    // Coarse timers may be off by 5%, a whole frame at low rates
+    mTimer.setTimerType(Qt::PreciseTimer);
+#endif
+    connect(&mTimer, SIGNAL(timeout()), this, SLOT(tick()));
+    if (getenv("MOZ_TARGET_FPS")) {
+        setTargetFrameRate(atoi(getenv("MOZ_TARGET_FPS")));
+    }
+}
+
+void FrameScheduler::removeClient(FrameSchedulerClient* aClient)
+{
+    mClients.remove(aClient);
+}
+
+void FrameScheduler::scheduleFrame(FrameSchedulerClient* aClient)
+{
+    ClientState& state = mClients[aClient];
+    if (state.mPending) {
+        mCoalescedFrames++;
+        return;
+    }
+    state.mPending = true;
+    startTimer();
+}
+
+void FrameScheduler::framePresented(FrameSchedulerClient* aClient)
+{
+    QHash<FrameSchedulerClient*, ClientState>::iterator it = mClients.find(aClient);
+    if (it != mClients.end()) {
+        it->mAwaitingPresent = false;
+    }
+}
+
+void FrameScheduler::setTargetFrameRate(int aFps)
+{
+    mTargetFps = qMax(0, aFps);
+    mNextTick = -1;
+}
+
+int FrameScheduler::targetFrameRate() const
+{
+    return mTargetFps;
+}
+
+void FrameScheduler::setBackgroundDivider(int aDivider)
+{
+    mBackgroundDivider = qMax(1, aDivider);
+}
+
+void FrameScheduler::setVsyncDriven(bool aVsyncDriven)
+{
+    mVsyncDriven = aVsyncDriven;
+    mTimer.stop();
+    startTimer();
+}
+
+bool FrameScheduler::vsyncDriven() const
+{
+    return mVsyncDriven;
+}
+
+QVariantMap FrameScheduler::statistics() const
+{
+    QVariantMap stats;
+    stats.insert("scheduled", mScheduledFrames);
+    stats.insert("coalesced", mCoalescedFrames);
+    stats.insert("dropped", mDroppedFrames);
+    stats.insert("throttled", mThrottledFrames);
+    return stats;
+}
+
+void FrameScheduler::vsync()
+{
+    if (mVsyncDriven) {
+        mTimer.stop();
+        tick();
+    }
+}
+
+void FrameScheduler::startTimer()
+{
+    if (mTimer.isActive()) {
+        return;
+    }
+    if (mVsyncDriven) {
+        // Displays signal vsync only after rendering something, an idle
+        // window would never get the frame that makes it render
+        mTimer.start(kVsyncTimeout);
+        return;
+    }
+    // Zero target rate means no pacing, frame is issued on next loop iteration
+    int remaining = 0;
+    if (mTargetFps > 0 && mNextTick >= 0) {
+        // Rounded up, the timer must not fire before the deadline
+        qint64 wait = mNextTick - mClock.nsecsElapsed();
+        remaining = wait > 0 ? int((wait + 999999) / 1000000) : 0;
+    }
+    mTimer.start(remaining);
+}
+
+void FrameScheduler::tick()
+{
+    if (mTargetFps > 0) {
+        // Deadlines advance by the exact interval, so rounding timer waits to
+        // whole ms doesn't drift the rate. After an idle period the cadence
+        // restarts instead of catching up with a burst
+        qint64 interval = Q_INT64_C(1000000000) / mTargetFps;
+        qint64 now = mClock.nsecsElapsed();
+        if (mNextTick < 0 || now - mNextTick >= interval) {
+            mNextTick = now + interval;
+        } else {
+            mNextTick += interval;
+        }
+    }
+    bool throttled = false;
+    QHash<FrameSchedulerClient*, ClientState>::iterator it;
+    for (it = mClients.begin(); it != mClients.end(); ++it) {
+        ClientState& state = it.value();
+        if (!state.mPending) {
+            continue;
+        }
+        if (!it.key()->IsFrameActive() && ++state.mSkippedFrames < mBackgroundDivider) {
+            mThrottledFrames++;
+            throttled = true;
+            continue;
+        }
+        if (state.mAwaitingPresent) {
+            // Previous frame of this client missed its slot
+            mDroppedFrames++;
+        }
+        state.mPending = false;
+        state.mAwaitingPresent = true;
+        state.mSkippedFrames = 0;
+        mScheduledFrames++;
+        it.key()->ScheduledFrame();
+    }
+    if (throttled) {
+        startTimer();
+    }
+}
@@ -0,0 +1,86 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVariantMap>
+
+/*!
+ * Implemented by views whose repaints are paced by FrameScheduler.
+ */
+class FrameSchedulerClient
+{
+public:
+    virtual ~FrameSchedulerClient() {}
+    // Frame is due, client should request its repaint now
+    virtual void ScheduledFrame() = 0;
+    // Inactive clients are throttled to a fraction of the frame rate
+    virtual bool IsFrameActive() const = 0;
+};
+
+/*!
+ * Coalesces invalidations coming from Gecko into at most one repaint per
+ * client per frame. Frames are issued by a timer running at the target
+ * rate, or by vsync() when the scheduler is vsync driven. Vsync driven
+ * frames still come from the timer when no vsync() follows within 50 ms,
+ * as happens while the display is idle.
+ */
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameScheduler(QObject* parent = 0);
+
+    void removeClient(FrameSchedulerClient* aClient);
+    void scheduleFrame(FrameSchedulerClient* aClient);
+    void framePresented(FrameSchedulerClient* aClient);
+
+    void setTargetFrameRate(int aFps);
+    int targetFrameRate() const;
+    // Inactive clients get one of every aDivider frames
+    void setBackgroundDivider(int aDivider);
+    void setVsyncDriven(bool aVsyncDriven);
+    bool vsyncDriven() const;
+
+    QVariantMap statistics() const;
+
+public Q_SLOTS:
+    void vsync();
+
+private Q_SLOTS:
+    void tick();
+
+private:
+    struct ClientState {
+        ClientState() : mPending(false), mAwaitingPresent(false), mSkippedFrames(0) {}
+        bool mPending;
+        bool mAwaitingPresent;
+        int mSkippedFrames;
+    };
+
+    void startTimer();
+
+    QHash<FrameSchedulerClient*, ClientState> mClients;
+    QTimer mTimer;
+    QElapsedTimer mClock;
+    // Earliest time of the next paced frame in ns on mClock, -1 if none yet
+    qint64 mNextTick;
+    int mTargetFps;
+    int mBackgroundDivider;
+    bool mVsyncDriven;
+    int mScheduledFrames;
+    int mCoalescedFrames;
+    int mDroppedFrames;
+    int mThrottledFrames;
+};
+
+#endif
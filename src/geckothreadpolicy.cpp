@@ -0,0 +1,276 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#define LOG_COMPONENT "GeckoThreadPolicy"
+
+#include <QMutexLocker>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "geckothreadpolicy.h"
+#include "mozilla/embedlite/EmbedLog.h"
+
+#ifndef Q_OS_LINUX
+// Only used as identifiers when the platform can't apply them
+#define SCHED_OTHER 0
+#define SCHED_FIFO 1
+#define SCHED_RR 2
+#endif
+
+static const char* const kPriorityNames[] = {
+    "idle", "lowest", "low", "normal", "high", "highest", "timecritical", "inherit"
+};
+
+static bool PriorityFromName(const QString& aName, QThread::Priority* aPriority)
+{
+    for (int i = 0; i <= QThread::InheritPriority; ++i) {
+        if (aName == QLatin1String(kPriorityNames[i])) {
+            *aPriority = QThread::Priority(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool SchedulerFromName(const QString& aName, int* aScheduler)
+{
+    if (aName == QLatin1String("other")) {
+        *aScheduler = SCHED_OTHER;
+    } else if (aName == QLatin1String("fifo")) {
+        *aScheduler = SCHED_FIFO;
+    } else if (aName == QLatin1String("rr")) {
+        *aScheduler = SCHED_RR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static QString SchedulerName(int aScheduler)
+{
+    switch (aScheduler) {
+    case SCHED_FIFO:
+        return QLatin1String("fifo");
+    case SCHED_RR:
+        return QLatin1String("rr");
+    default:
+        return QLatin1String("other");
+    }
+}
+
+GeckoThreadPolicy::GeckoThreadPolicy()
+    : mPriority(QThread::LowPriority)
+    , mHasNice(false)
+    , mNice(0)
+    , mAffinity(0)
+    , mInheritedNice(0)
+    , mInheritedAffinity(0)
+    , mNiceApplied(false)
+    , mAffinityApplied(false)
+    , mScheduler(SCHED_OTHER)
+    , mRealtimePriority(1)
+    , mRealtimeApplied(false)
+    , mTid(0)
+{
+}
+
+void GeckoThreadPolicy::loadFromEnvironment()
+{
+    QMutexLocker lock(&mMutex);
+    if (getenv("GECKO_THREAD_NICE")) {
+        mHasNice = true;
+        mNice = atoi(getenv("GECKO_THREAD_NICE"));
+    }
+    if (getenv("GECKO_THREAD_AFFINITY")) {
+        mAffinity = strtoull(getenv("GECKO_THREAD_AFFINITY"), NULL, 0);
+    }
+    if (getenv("GECKO_THREAD_SCHED") &&
+        !SchedulerFromName(QString::fromLatin1(getenv("GECKO_THREAD_SCHED")), &mScheduler)) {
+        LOGT("Unknown GECKO_THREAD_SCHED: %s", getenv("GECKO_THREAD_SCHED"));
+    }
+    if (getenv("GECKO_THREAD_RT_PRIORITY")) {
+        mRealtimePriority = atoi(getenv("GECKO_THREAD_RT_PRIORITY"));
+    }
+}
+
+bool GeckoThreadPolicy::update(const QVariantMap& aPolicy)
+{
+    QMutexLocker lock(&mMutex);
+    bool ok = true;
+    if (aPolicy.contains("priority") &&
+        !PriorityFromName(aPolicy.value("priority").toString(), &mPriority)) {
+        LOGT("Unknown priority: %s", aPolicy.value("priority").toString().toUtf8().data());
+        ok = false;
+    }
+    if (aPolicy.contains("nice")) {
+        QVariant nice = aPolicy.value("nice");
+        bool valid = true;
+        int value = nice.toInt(&valid);
+        if (!nice.isValid()) {
+            // Goes back to the nice value inherited at attach
+            mHasNice = false;
+        } else if (valid) {
+            mHasNice = true;
+            mNice = value;
+        } else {
+            LOGT("Invalid nice: %s", nice.toString().toUtf8().data());
+            ok = false;
+        }
+    }
+    if (aPolicy.contains("affinity")) {
+        // Empty list goes back to the affinity inherited at attach
+        mAffinity = 0;
+        Q_FOREACH(const QVariant& cpu, aPolicy.value("affinity").toList()) {
+            int index = cpu.toInt();
+            if (index < 0 || index > 63) {
+                LOGT("CPU index out of range: %i", index);
+                ok = false;
+                continue;
+            }
+            mAffinity |= Q_UINT64_C(1) << index;
+        }
+    }
+    if (aPolicy.contains("scheduler") &&
+        !SchedulerFromName(aPolicy.value("scheduler").toString(), &mScheduler)) {
+        LOGT("Unknown scheduler: %s", aPolicy.value("scheduler").toString().toUtf8().data());
+        ok = false;
+    }
+    if (aPolicy.contains("realtimePriority")) {
+        mRealtimePriority = aPolicy.value("realtimePriority").toInt();
+    }
+    return ok;
+}
+
+QVariantMap GeckoThreadPolicy::toVariantMap() const
+{
+    QMutexLocker lock(&mMutex);
+    QVariantMap policy;
+    policy.insert("priority", QString::fromLatin1(kPriorityNames[mPriority]));
+    if (mHasNice) {
+        policy.insert("nice", mNice);
+    }
+    QVariantList affinity;
+    for (int cpu = 0; cpu < 64; ++cpu) {
+        if (mAffinity & (Q_UINT64_C(1) << cpu)) {
+            affinity.append(cpu);
+        }
+    }
+    policy.insert("affinity", affinity);
+    policy.insert("scheduler", SchedulerName(mScheduler));
+    policy.insert("realtimePriority", mRealtimePriority);
+    policy.insert("threadId", mTid);
+    return policy;
+}
+
+QThread::Priority GeckoThreadPolicy::priority() const
+{
+    QMutexLocker lock(&mMutex);
+    return mPriority;
+}
+
+void GeckoThreadPolicy::attachCurrentThread()
+{
+    QMutexLocker lock(&mMutex);
+#ifdef Q_OS_LINUX
+    mTid = syscall(SYS_gettid);
+    pid_t tid = mTid;
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, tid);
+    mInheritedNice = errno ? 0 : nice;
+    mInheritedAffinity = 0;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(tid, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                mInheritedAffinity |= Q_UINT64_C(1) << cpu;
+            }
+        }
+    }
+    LOGT("tid:%lli, nice:%i, affinity:0x%llx", mTid, mInheritedNice, mInheritedAffinity);
+    applyLocked();
+#else
+    if (mHasNice || mAffinity || mScheduler != SCHED_OTHER) {
+        LOGT("Only the thread priority is supported on this platform");
+    }
+#endif
+}
+
+void GeckoThreadPolicy::detachThread()
+{
+    QMutexLocker lock(&mMutex);
+    mTid = 0;
+    mRealtimeApplied = false;
+    mNiceApplied = false;
+    mAffinityApplied = false;
+}
+
+bool GeckoThreadPolicy::apply()
+{
+    QMutexLocker lock(&mMutex);
+    return applyLocked();
+}
+
+bool GeckoThreadPolicy::applyLocked()
+{
+    if (!mTid) {
+        return false;
+    }
+    bool ok = true;
+#ifdef Q_OS_LINUX
+    pid_t tid = mTid;
+    // Left alone unless asked for, QThread maps its idle priority to a class
+    if (mScheduler != SCHED_OTHER || mRealtimeApplied) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        if (mScheduler != SCHED_OTHER) {
+            param.sched_priority = qBound(sched_get_priority_min(mScheduler), mRealtimePriority,
+                                          sched_get_priority_max(mScheduler));
+        }
+        if (sched_setscheduler(tid, mScheduler, &param) == 0) {
+            mRealtimeApplied = mScheduler != SCHED_OTHER;
+        } else {
+            // Realtime classes need CAP_SYS_NICE or an RLIMIT_RTPRIO allowance
+            LOGT("sched_setscheduler(%s) failed: %s", SchedulerName(mScheduler).toUtf8().data(), strerror(errno));
+            ok = false;
+        }
+    }
+    if (mHasNice || mNiceApplied) {
+        int nice = mHasNice ? mNice : mInheritedNice;
+        if (setpriority(PRIO_PROCESS, tid, nice) == 0) {
+            mNiceApplied = mHasNice;
+        } else {
+            // Lowering the value again needs CAP_SYS_NICE or RLIMIT_NICE
+            LOGT("setpriority(%i) failed: %s", nice, strerror(errno));
+            ok = false;
+        }
+    }
+    quint64 affinity = mAffinity ? mAffinity : (mAffinityApplied ? mInheritedAffinity : 0);
+    if (affinity) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu) {
+            if (affinity & (Q_UINT64_C(1) << cpu)) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        if (sched_setaffinity(tid, sizeof(set), &set) == 0) {
+            mAffinityApplied = mAffinity != 0;
+        } else {
+            LOGT("sched_setaffinity(0x%llx) failed: %s", affinity, strerror(errno));
+            ok = false;
+        }
+    }
+#endif
+    return ok;
+}
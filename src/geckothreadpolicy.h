@@ -0,0 +1,61 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef GECKOTHREADPOLICY_H
+#define GECKOTHREADPOLICY_H
+
+#include <QMutex>
+#include <QThread>
+#include <QVariantMap>
+
+/*!
+ * Scheduling settings of the Gecko thread: QThread priority, nice value,
+ * CPU affinity and scheduling class. Settings can change at any time, they
+ * reach the kernel while a thread is attached. Applying anything but the
+ * QThread priority is only supported on Linux.
+ */
+class GeckoThreadPolicy
+{
+public:
+    GeckoThreadPolicy();
+
+    // GECKO_THREAD_NICE, GECKO_THREAD_AFFINITY (CPU mask, e.g. 0xc),
+    // GECKO_THREAD_SCHED (other, fifo, rr) and GECKO_THREAD_RT_PRIORITY
+    void loadFromEnvironment();
+    // Merges the known keys of aPolicy, returns false if any was invalid
+    bool update(const QVariantMap& aPolicy);
+    QVariantMap toVariantMap() const;
+    QThread::Priority priority() const;
+
+    // Called on the Gecko thread once it runs and when it stops
+    void attachCurrentThread();
+    void detachThread();
+    // Pushes the settings to the attached thread, if any
+    bool apply();
+
+private:
+    bool applyLocked();
+
+    mutable QMutex mMutex;
+    QThread::Priority mPriority;
+    bool mHasNice;
+    int mNice;
+    // Bit n allows CPU n, 0 keeps the inherited affinity
+    quint64 mAffinity;
+    // What the thread had when attached, restored once a setting is dropped
+    int mInheritedNice;
+    quint64 mInheritedAffinity;
+    bool mNiceApplied;
+    bool mAffinityApplied;
+    int mScheduler;
+    int mRealtimePriority;
+    // Realtime class was set, going back to "other" must be explicit
+    bool mRealtimeApplied;
+    // Kernel thread id, 0 when not attached
+    qint64 mTid;
+};
+
+#endif
@@ -5,19 +5,24 @@
  * You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "geckoworker.h"
+#include "geckothreadpolicy.h"
 #include "nsDebug.h"
 #include "mozilla/embedlite/EmbedLiteApp.h"
 
 using namespace mozilla::embedlite;
 
-GeckoWorker::GeckoWorker(EmbedLiteApp* aApp, QObject* parent)
+GeckoWorker::GeckoWorker(EmbedLiteApp* aApp, GeckoThreadPolicy* aPolicy, QObject* parent)
     : QObject(parent),
-      mApp(aApp)
+      mApp(aApp),
+      mPolicy(aPolicy)
 {
 }
 
 void GeckoWorker::doWork()
 {
+    if (mPolicy) {
+        mPolicy->attachCurrentThread();
+    }
     mApp->StartChildThread();
 }
 
@@ -25,5 +30,8 @@ void GeckoWorker::quit()
 {
     printf("Call EmbedLiteApp::StopChildThread()\n");
     mApp->StopChildThread();
+    if (mPolicy) {
+        mPolicy->detachThread();
+    }
     deleteLater();
 }
@@ -14,6 +14,8 @@ namespace embedlite {
 class EmbedLiteApp;
 }}
 
+class GeckoThreadPolicy;
+
 /*!
  * An instance of this class runs in its own thread/event loop and is used to
  * host EmbedLiteApp's event loop.
@@ -23,7 +25,8 @@ class GeckoWorker : public QObject
     Q_OBJECT
 
 public:
-    explicit GeckoWorker(mozilla::embedlite::EmbedLiteApp* aApp, QObject* parent = 0);
+    // aPolicy is attached to the worker thread while it runs Gecko
+    explicit GeckoWorker(mozilla::embedlite::EmbedLiteApp* aApp, GeckoThreadPolicy* aPolicy = 0, QObject* parent = 0);
 
 public Q_SLOTS:
     void doWork();
@@ -31,6 +34,7 @@ public Q_SLOTS:
 
 private:
     mozilla::embedlite::EmbedLiteApp* mApp;
+    GeckoThreadPolicy* mPolicy;
 };
 
 #endif
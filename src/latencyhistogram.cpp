@@ -0,0 +1,83 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#define LOG_COMPONENT "LatencyHistogram"
+
+#include <QMutexLocker>
+#include <string.h>
+
+#include "latencyhistogram.h"
+#include "mozilla/embedlite/EmbedLog.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    QMutexLocker lock(&mMutex);
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mMax = 0;
+    mSum = 0;
+}
+
+void LatencyHistogram::record(qint64 aUsec)
+{
+    // Bucket i holds durations in [2^(i-1), 2^i) microseconds
+    int bucket = 0;
+    for (qint64 v = aUsec; v > 0 && bucket < kBuckets - 1; v >>= 1) {
+        bucket++;
+    }
+    QMutexLocker lock(&mMutex);
+    mBuckets[bucket]++;
+    mCount++;
+    mSum += aUsec;
+    mMax = qMax(mMax, aUsec);
+}
+
+double LatencyHistogram::percentile(double aFraction) const
+{
+    if (!mCount) {
+        return 0;
+    }
+    quint32 target = qMax<quint32>(1, qRound(aFraction * mCount));
+    quint32 seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        if (seen + mBuckets[i] >= target) {
+            // Interpolate linearly inside the bucket
+            double low = i ? double(Q_INT64_C(1) << (i - 1)) : 0;
+            double high = double(Q_INT64_C(1) << i);
+            double pos = double(target - seen) / mBuckets[i];
+            return qMin<double>(low + (high - low) * pos, mMax);
+        }
+        seen += mBuckets[i];
+    }
+    return mMax;
+}
+
+QVariantMap LatencyHistogram::toVariantMap() const
+{
+    QMutexLocker lock(&mMutex);
+    QVariantMap map;
+    map.insert("count", mCount);
+    map.insert("max", mMax / 1000.0);
+    map.insert("mean", mCount ? mSum / 1000.0 / mCount : 0.0);
+    map.insert("p50", percentile(0.50) / 1000.0);
+    map.insert("p95", percentile(0.95) / 1000.0);
+    map.insert("p99", percentile(0.99) / 1000.0);
+    return map;
+}
+
+void LatencyHistogram::dump(const char* aName) const
+{
+    QVariantMap map = toVariantMap();
+    LOGT("%s: count:%u, mean:%.2f, p50:%.2f, p95:%.2f, p99:%.2f, max:%.2f ms", aName,
+         map.value("count").toUInt(), map.value("mean").toDouble(),
+         map.value("p50").toDouble(), map.value("p95").toDouble(),
+         map.value("p99").toDouble(), map.value("max").toDouble());
+}
@@ -0,0 +1,63 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVariantMap>
+
+/*!
+ * Histogram of call durations with power of two microsecond buckets.
+ * Recording is cheap enough to stay enabled in production, and may happen
+ * on any thread.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(qint64 aUsec);
+    void reset();
+    // count, max, mean, p50, p95 and p99, durations in milliseconds
+    QVariantMap toVariantMap() const;
+    // Logs a one line summary with LOGT, toVariantMap() for anything else
+    void dump(const char* aName) const;
+
+private:
+    enum { kBuckets = 32 };
+
+    double percentile(double aFraction) const;
+
+    mutable QMutex mMutex;
+    quint32 mBuckets[kBuckets];
+    quint32 mCount;
+    qint64 mMax;
+    qint64 mSum;
+};
+
+/*!
+ * Records time spent in its scope into a histogram.
+ */
+class LatencyScope
+{
+public:
+    explicit LatencyScope(LatencyHistogram& aHistogram)
+      : mHistogram(aHistogram)
+    {
+        mTimer.start();
+    }
+    ~LatencyScope() {
+        mHistogram.record(mTimer.nsecsElapsed() / 1000);
+    }
+
+private:
+    LatencyHistogram& mHistogram;
+    QElapsedTimer mTimer;
+};
+
+#endif
@@ -0,0 +1,581 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QStringList>
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+#include <qjson/parser.h>
+#else
+#include <QJsonDocument>
+#include <QJsonParseError>
+#endif
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include "messagecodec.h"
+
+namespace {
+
+enum MajorType {
+    kUnsigned = 0,
+    kNegative = 1,
+    kBytes = 2,
+    kText = 3,
+    kArray = 4,
+    kMap = 5,
+    kTag = 6,
+    kSimple = 7
+};
+
+static const int kMaxDepth = 128;
+
+void WriteHead(QByteArray& aOut, int aMajor, quint64 aValue)
+{
+    char major = char(aMajor << 5);
+    if (aValue < 24) {
+        aOut.append(char(major | aValue));
+    } else if (aValue <= 0xff) {
+        aOut.append(char(major | 24));
+        aOut.append(char(aValue));
+    } else if (aValue <= 0xffff) {
+        aOut.append(char(major | 25));
+        aOut.append(char(aValue >> 8));
+        aOut.append(char(aValue));
+    } else if (aValue <= 0xffffffffULL) {
+        aOut.append(char(major | 26));
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            aOut.append(char(aValue >> shift));
+        }
+    } else {
+        aOut.append(char(major | 27));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            aOut.append(char(aValue >> shift));
+        }
+    }
+}
+
+void WriteInteger(QByteArray& aOut, qint64 aValue)
+{
+    if (aValue >= 0) {
+        WriteHead(aOut, kUnsigned, quint64(aValue));
+    } else {
+        WriteHead(aOut, kNegative, quint64(-1 - aValue));
+    }
+}
+
+void WriteDouble(QByteArray& aOut, double aValue)
+{
+    quint64 bits;
+    memcpy(&bits, &aValue, sizeof(bits));
+    aOut.append(char((kSimple << 5) | 27));
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        aOut.append(char(bits >> shift));
+    }
+}
+
+void WriteText(QByteArray& aOut, const QString& aText)
+{
+    QByteArray utf8 = aText.toUtf8();
+    WriteHead(aOut, kText, utf8.size());
+    aOut.append(utf8);
+}
+
+void Write(QByteArray& aOut, const QVariant& aVariant)
+{
+    switch (int(aVariant.type())) {
+    case QVariant::Invalid:
+        aOut.append(char((kSimple << 5) | 22));
+        break;
+    case QVariant::Bool:
+        aOut.append(char((kSimple << 5) | (aVariant.toBool() ? 21 : 20)));
+        break;
+    case QVariant::Int:
+    case QVariant::LongLong:
+        WriteInteger(aOut, aVariant.toLongLong());
+        break;
+    case QVariant::UInt:
+    case QVariant::ULongLong:
+        WriteHead(aOut, kUnsigned, aVariant.toULongLong());
+        break;
+    case QMetaType::Float:
+    case QVariant::Double:
+        WriteDouble(aOut, aVariant.toDouble());
+        break;
+    case QVariant::String:
+        WriteText(aOut, aVariant.toString());
+        break;
+    case QVariant::ByteArray: {
+        QByteArray bytes = aVariant.toByteArray();
+        WriteHead(aOut, kBytes, bytes.size());
+        aOut.append(bytes);
+        break;
+    }
+    case QVariant::StringList: {
+        QStringList list = aVariant.toStringList();
+        WriteHead(aOut, kArray, list.size());
+        Q_FOREACH(const QString& str, list) {
+            WriteText(aOut, str);
+        }
+        break;
+    }
+    case QVariant::List: {
+        QVariantList list = aVariant.toList();
+        WriteHead(aOut, kArray, list.size());
+        Q_FOREACH(const QVariant& item, list) {
+            Write(aOut, item);
+        }
+        break;
+    }
+    case QVariant::Map: {
+        QVariantMap map = aVariant.toMap();
+        WriteHead(aOut, kMap, map.size());
+        for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+            WriteText(aOut, it.key());
+            Write(aOut, it.value());
+        }
+        break;
+    }
+    case QVariant::Hash: {
+        QVariantHash hash = aVariant.toHash();
+        WriteHead(aOut, kMap, hash.size());
+        for (QVariantHash::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it) {
+            WriteText(aOut, it.key());
+            Write(aOut, it.value());
+        }
+        break;
+    }
+    default:
+        if (aVariant.canConvert(QVariant::String)) {
+            WriteText(aOut, aVariant.toString());
+        } else {
+            aOut.append(char((kSimple << 5) | 22));
+        }
+        break;
+    }
+}
+
+void WriteJsonString(QString& aOut, const QString& aText)
+{
+    static const char kHex[] = "0123456789abcdef";
+    aOut.append(QLatin1Char('"'));
+    const QChar* begin = aText.constData();
+    const QChar* end = begin + aText.size();
+    const QChar* run = begin;
+    for (const QChar* c = begin; c != end; ++c) {
+        ushort u = c->unicode();
+        if (u >= 0x20 && u != '"' && u != '\\') {
+            continue;
+        }
+        aOut.append(QStringRef(&aText, run - begin, c - run));
+        run = c + 1;
+        aOut.append(QLatin1Char('\\'));
+        switch (u) {
+        case '"': aOut.append(QLatin1Char('"')); break;
+        case '\\': aOut.append(QLatin1Char('\\')); break;
+        case '\b': aOut.append(QLatin1Char('b')); break;
+        case '\f': aOut.append(QLatin1Char('f')); break;
+        case '\n': aOut.append(QLatin1Char('n')); break;
+        case '\r': aOut.append(QLatin1Char('r')); break;
+        case '\t': aOut.append(QLatin1Char('t')); break;
+        default:
+            aOut.append(QLatin1String("u00"));
+            aOut.append(QLatin1Char(kHex[u >> 4]));
+            aOut.append(QLatin1Char(kHex[u & 0xf]));
+            break;
+        }
+    }
+    aOut.append(QStringRef(&aText, run - begin, end - run));
+    aOut.append(QLatin1Char('"'));
+}
+
+void WriteJsonDouble(QString& aOut, double aValue)
+{
+    if (aValue != aValue || aValue == HUGE_VAL || aValue == -HUGE_VAL) {
+        // Not representable in JSON
+        aOut.append(QLatin1String("null"));
+        return;
+    }
+    // Shortest of the two that reads back exactly
+    QString number = QString::number(aValue, 'g', 15);
+    if (number.toDouble() != aValue) {
+        number = QString::number(aValue, 'g', 17);
+    }
+    aOut.append(number);
+}
+
+void WriteJsonValue(QString& aOut, const QVariant& aVariant)
+{
+    switch (int(aVariant.type())) {
+    case QVariant::Invalid:
+        aOut.append(QLatin1String("null"));
+        break;
+    case QVariant::Bool:
+        aOut.append(aVariant.toBool() ? QLatin1String("true") : QLatin1String("false"));
+        break;
+    case QVariant::Int:
+    case QVariant::LongLong:
+        aOut.append(QString::number(aVariant.toLongLong()));
+        break;
+    case QVariant::UInt:
+    case QVariant::ULongLong:
+        aOut.append(QString::number(aVariant.toULongLong()));
+        break;
+    case QMetaType::Float:
+    case QVariant::Double:
+        WriteJsonDouble(aOut, aVariant.toDouble());
+        break;
+    case QVariant::String:
+        WriteJsonString(aOut, aVariant.toString());
+        break;
+    case QVariant::StringList: {
+        aOut.append(QLatin1Char('['));
+        bool first = true;
+        Q_FOREACH(const QString& str, aVariant.toStringList()) {
+            if (!first) {
+                aOut.append(QLatin1Char(','));
+            }
+            first = false;
+            WriteJsonString(aOut, str);
+        }
+        aOut.append(QLatin1Char(']'));
+        break;
+    }
+    case QVariant::List: {
+        aOut.append(QLatin1Char('['));
+        const QVariantList list = aVariant.toList();
+        for (int i = 0; i < list.size(); ++i) {
+            if (i) {
+                aOut.append(QLatin1Char(','));
+            }
+            WriteJsonValue(aOut, list.at(i));
+        }
+        aOut.append(QLatin1Char(']'));
+        break;
+    }
+    case QVariant::Map: {
+        aOut.append(QLatin1Char('{'));
+        const QVariantMap map = aVariant.toMap();
+        for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+            if (it != map.constBegin()) {
+                aOut.append(QLatin1Char(','));
+            }
+            WriteJsonString(aOut, it.key());
+            aOut.append(QLatin1Char(':'));
+            WriteJsonValue(aOut, it.value());
+        }
+        aOut.append(QLatin1Char('}'));
+        break;
+    }
+    case QVariant::Hash: {
+        aOut.append(QLatin1Char('{'));
+        const QVariantHash hash = aVariant.toHash();
+        for (QVariantHash::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it) {
+            if (it != hash.constBegin()) {
+                aOut.append(QLatin1Char(','));
+            }
+            WriteJsonString(aOut, it.key());
+            aOut.append(QLatin1Char(':'));
+            WriteJsonValue(aOut, it.value());
+        }
+        aOut.append(QLatin1Char('}'));
+        break;
+    }
+    default:
+        if (aVariant.canConvert(QVariant::String)) {
+            WriteJsonString(aOut, aVariant.toString());
+        } else {
+            aOut.append(QLatin1String("null"));
+        }
+        break;
+    }
+}
+
+class Reader
+{
+public:
+    Reader(const QByteArray& aData)
+      : mData(reinterpret_cast<const uchar*>(aData.constData()))
+      , mSize(aData.size())
+      , mPos(0)
+      , mOk(true)
+    {
+    }
+
+    bool AtEnd() const { return mPos >= mSize; }
+    bool Ok() const { return mOk; }
+
+    QVariant Read(int aDepth = 0);
+
+private:
+    bool Fail() { mOk = false; return false; }
+    // Consumes the break ending an indefinite length item, input running
+    // out before it is an error
+    bool ReadBreak();
+    bool ReadUInt(int aInfo, quint64& aValue);
+    QByteArray ReadChunks(int aMajor, int aInfo);
+
+    const uchar* mData;
+    int mSize;
+    int mPos;
+    bool mOk;
+};
+
+bool Reader::ReadUInt(int aInfo, quint64& aValue)
+{
+    if (aInfo < 24) {
+        aValue = aInfo;
+        return true;
+    }
+    if (aInfo > 27) {
+        return Fail();
+    }
+    int bytes = 1 << (aInfo - 24);
+    if (mPos + bytes > mSize) {
+        return Fail();
+    }
+    aValue = 0;
+    for (int i = 0; i < bytes; ++i) {
+        aValue = (aValue << 8) | mData[mPos++];
+    }
+    return true;
+}
+
+bool Reader::ReadBreak()
+{
+    if (!mOk || mPos >= mSize || mData[mPos] != 0xff) {
+        return Fail();
+    }
+    mPos++;
+    return true;
+}
+
+QByteArray Reader::ReadChunks(int aMajor, int aInfo)
+{
+    if (aInfo == 31) {
+        // Indefinite length, definite chunks of the same type until break
+        QByteArray result;
+        while (mOk && mPos < mSize && mData[mPos] != 0xff) {
+            int head = mData[mPos++];
+            if ((head >> 5) != aMajor || (head & 0x1f) == 31) {
+                Fail();
+                break;
+            }
+            result.append(ReadChunks(aMajor, head & 0x1f));
+        }
+        ReadBreak();
+        return result;
+    }
+    quint64 length;
+    if (!ReadUInt(aInfo, length) || length > quint64(mSize - mPos)) {
+        Fail();
+        return QByteArray();
+    }
+    QByteArray result(reinterpret_cast<const char*>(mData + mPos), int(length));
+    mPos += int(length);
+    return result;
+}
+
+QVariant Reader::Read(int aDepth)
+{
+    if (mPos >= mSize || aDepth > kMaxDepth) {
+        Fail();
+        return QVariant();
+    }
+    int head = mData[mPos++];
+    int major = head >> 5;
+    int info = head & 0x1f;
+    quint64 value = 0;
+
+    switch (major) {
+    case kUnsigned:
+        if (!ReadUInt(info, value)) {
+            return QVariant();
+        }
+        if (value <= quint64(INT_MAX)) {
+            return QVariant(int(value));
+        }
+        return value <= quint64(LLONG_MAX) ? QVariant(qlonglong(value)) : QVariant(qulonglong(value));
+    case kNegative:
+        if (!ReadUInt(info, value)) {
+            return QVariant();
+        }
+        if (value < quint64(INT_MAX)) {
+            return QVariant(int(-1 - qint64(value)));
+        }
+        if (value > quint64(LLONG_MAX)) {
+            // Below the qint64 range, keep the magnitude like script does
+            return QVariant(-1.0 - double(value));
+        }
+        return QVariant(qlonglong(-1 - qint64(value)));
+    case kBytes:
+        return ReadChunks(kBytes, info);
+    case kText:
+        return QString::fromUtf8(ReadChunks(kText, info));
+    case kArray: {
+        QVariantList list;
+        if (info == 31) {
+            while (mOk && mPos < mSize && mData[mPos] != 0xff) {
+                list.append(Read(aDepth + 1));
+            }
+            ReadBreak();
+        } else if (ReadUInt(info, value) && value <= quint64(mSize - mPos)) {
+            for (quint64 i = 0; mOk && i < value; ++i) {
+                list.append(Read(aDepth + 1));
+            }
+        } else {
+            Fail();
+        }
+        return list;
+    }
+    case kMap: {
+        QVariantMap map;
+        if (info == 31) {
+            while (mOk && mPos < mSize && mData[mPos] != 0xff) {
+                QString key = Read(aDepth + 1).toString();
+                map.insert(key, Read(aDepth + 1));
+            }
+            ReadBreak();
+        } else if (ReadUInt(info, value) && value <= quint64(mSize - mPos)) {
+            for (quint64 i = 0; mOk && i < value; ++i) {
+                QString key = Read(aDepth + 1).toString();
+                map.insert(key, Read(aDepth + 1));
+            }
+        } else {
+            Fail();
+        }
+        return map;
+    }
+    case kTag:
+        // Tags carry no meaning for us, use the tagged item as is
+        if (!ReadUInt(info, value)) {
+            return QVariant();
+        }
+        return Read(aDepth + 1);
+    default:
+        break;
+    }
+
+    // Simple values and floats
+    switch (info) {
+    case 20:
+        return false;
+    case 21:
+        return true;
+    case 22:
+    case 23:
+        return QVariant();
+    case 25: {
+        if (!ReadUInt(info, value)) {
+            return QVariant();
+        }
+        int exponent = (value >> 10) & 0x1f;
+        int mantissa = value & 0x3ff;
+        double result;
+        if (exponent == 0) {
+            result = ldexp(double(mantissa), -24);
+        } else if (exponent != 31) {
+            result = ldexp(double(mantissa + 1024), exponent - 25);
+        } else {
+            result = mantissa == 0 ? HUGE_VAL : NAN;
+        }
+        return (value & 0x8000) ? -result : result;
+    }
+    case 26: {
+        if (!ReadUInt(info, value)) {
+            return QVariant();
+        }
+        quint32 bits = quint32(value);
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return double(result);
+    }
+    case 27: {
+        if (!ReadUInt(info, value)) {
+            return QVariant();
+        }
+        double result;
+        memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+    default:
+        if (info < 24) {
+            return QVariant();
+        }
+        Fail();
+        return QVariant();
+    }
+}
+
+} // namespace
+
+QByteArray MessageCodec::EncodeCbor(const QVariant& aVariant)
+{
+    QByteArray out;
+    Write(out, aVariant);
+    return out;
+}
+
+QVariant MessageCodec::DecodeCbor(const QByteArray& aData, bool* aOk)
+{
+    Reader reader(aData);
+    QVariant result = reader.Read();
+    if (aOk) {
+        *aOk = reader.Ok() && reader.AtEnd();
+    }
+    return result;
+}
+
+void MessageCodec::WriteJson(const QVariant& aVariant, QString& aOut)
+{
+    WriteJsonValue(aOut, aVariant);
+}
+
+QVariant MessageCodec::DecodeJson(const QChar* aData, int aLength, bool* aOk, QString* aError)
+{
+    QByteArray utf8 = QString::fromRawData(aData, aLength).toUtf8();
+    bool ok = false;
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+    QJson::Parser parser;
+    QVariant result = parser.parse(utf8, &ok);
+    if (!ok && aError) {
+        *aError = QString("%1 at line %2").arg(parser.errorString()).arg(parser.errorLine());
+    }
+#else
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(utf8, &error);
+    ok = error.error == QJsonParseError::NoError;
+    QVariant result = doc.toVariant();
+    if (!ok && aError) {
+        *aError = QString("%1 at offset %2").arg(error.errorString()).arg(error.offset);
+    }
+#endif
+    if (aOk) {
+        *aOk = ok;
+    }
+    return result;
+}
+
+QString MessageCodec::EncodeBinaryPayload(const QVariant& aVariant)
+{
+    return QString::fromLatin1("\"" + EncodeCbor(aVariant).toBase64() + "\"");
+}
+
+QVariant MessageCodec::DecodeBinaryPayload(const QChar* aData, int aLength, bool* aOk)
+{
+    if (aLength < 2 || aData[0] != QLatin1Char('"') || aData[aLength - 1] != QLatin1Char('"')) {
+        if (aOk) {
+            *aOk = false;
+        }
+        return QVariant();
+    }
+    // Base64 alphabet never needs JSON escaping, so the string is taken as is
+    QByteArray base64;
+    base64.resize(aLength - 2);
+    for (int i = 1; i < aLength - 1; ++i) {
+        base64[i - 1] = aData[i].toLatin1();
+    }
+    return DecodeCbor(QByteArray::fromBase64(base64), aOk);
+}
@@ -0,0 +1,47 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef MESSAGECODEC_H
+#define MESSAGECODEC_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+/*!
+ * Compact binary (CBOR, RFC 7049) encoding of message payloads.
+ *
+ * Content side expects message data to be JSON, so binary payloads travel
+ * as a single base64 JSON string. Frame scripts decode them with
+ * messagecodec.js installed next to the library.
+ *
+ * This is not a performance option: decoding in script is several times
+ * slower than JSON.parse (see tests/benchmarks/messagecodec/messagecodec_bench.js)
+ * and base64 adds a third to the size. Use it for data JSON can't carry,
+ * QByteArray values arrive as Uint8Array and 64 bit integers keep their type.
+ */
+class MessageCodec
+{
+public:
+    static QByteArray EncodeCbor(const QVariant& aVariant);
+    static QVariant DecodeCbor(const QByteArray& aData, bool* aOk = 0);
+
+    // Appends aVariant as compact JSON to aOut without intermediate copies.
+    // Callers keep aOut around to reuse its capacity: reserve() it once,
+    // Qt frees the storage of an unreserved string truncated to 0.
+    static void WriteJson(const QVariant& aVariant, QString& aOut);
+    // Initial capacity of reused WriteJson buffers, in characters
+    static const int kBufferReserve = 4096;
+    // Parses JSON message data, aError receives the parser message on failure
+    static QVariant DecodeJson(const QChar* aData, int aLength, bool* aOk = 0, QString* aError = 0);
+
+    // Wraps CBOR encoded aVariant into a quoted base64 JSON string
+    static QString EncodeBinaryPayload(const QVariant& aVariant);
+    // Reverse of EncodeBinaryPayload, aData is the JSON text as received
+    static QVariant DecodeBinaryPayload(const QChar* aData, int aLength, bool* aOk = 0);
+};
+
+#endif
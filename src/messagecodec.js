@@ -0,0 +1,450 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * Frame script side of the binary message encoding, see messagecodec.h.
+ * Load it into a frame script with
+ *   Services.scriptloader.loadSubScript("file:///usr/share/qtmozembed/messagecodec.js");
+ * and use MessageCodec.decode(aMessage.json) for names the view has switched
+ * to "cbor" with setMessageEncoding(), MessageCodec.encode(obj) when sending.
+ * Views with messageBatching enabled batch only the names a frame script
+ * registered with MessageCodec.addBatchListener().
+ * Shared memory attachments are read with MessageCodec.readAttachment().
+ */
+"use strict";
+
+var MessageCodec = (function() {
+    const kBase64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const kMaxDepth = 128;
+
+    // Sextet per character code, 0xff for characters outside the alphabet
+    let base64Index = new Uint8Array(256);
+    for (let i = 0; i < base64Index.length; i++) {
+        base64Index[i] = 0xff;
+    }
+    for (let i = 0; i < kBase64.length; i++) {
+        base64Index[kBase64.charCodeAt(i)] = i;
+    }
+    // Bytes handed to String.fromCharCode at once, stays below argument limits
+    const kCharChunk = 0x2000;
+    // Message name -> listener registered with addBatchListener()
+    let batchListeners = null;
+    // Ticket -> callback of a deferred sendSyncMessage()
+    let syncCallbacks = null;
+
+    // Native UTF-8 decoding where the scope has it
+    let utf8Decoder = typeof TextDecoder == "function" ? new TextDecoder("utf-8", { fatal: true }) : null;
+
+    function toBase64(aBytes, aLength) {
+        let out = "";
+        let i = 0;
+        for (; i + 2 < aLength; i += 3) {
+            let n = (aBytes[i] << 16) | (aBytes[i + 1] << 8) | aBytes[i + 2];
+            out += kBase64.charAt(n >> 18) + kBase64.charAt((n >> 12) & 63) +
+                   kBase64.charAt((n >> 6) & 63) + kBase64.charAt(n & 63);
+        }
+        if (i + 1 == aLength) {
+            let n = aBytes[i] << 16;
+            out += kBase64.charAt(n >> 18) + kBase64.charAt((n >> 12) & 63) + "==";
+        } else if (i + 2 == aLength) {
+            let n = (aBytes[i] << 16) | (aBytes[i + 1] << 8);
+            out += kBase64.charAt(n >> 18) + kBase64.charAt((n >> 12) & 63) +
+                   kBase64.charAt((n >> 6) & 63) + "=";
+        }
+        return out;
+    }
+
+    function fromBase64(aString) {
+        let bytes = new Uint8Array((aString.length * 3) >> 2);
+        let pos = 0;
+        let bits = 0;
+        let count = 0;
+        for (let i = 0; i < aString.length; i++) {
+            let code = aString.charCodeAt(i);
+            let sextet = code < 0x100 ? base64Index[code] : 0xff;
+            if (sextet == 0xff)
+                continue;
+            bits = ((bits << 6) | sextet) & 0xffffff;
+            count += 6;
+            if (count >= 8) {
+                count -= 8;
+                bytes[pos++] = (bits >> count) & 0xff;
+            }
+        }
+        return bytes.subarray(0, pos);
+    }
+
+    function Writer() {
+        this.bytes = new Uint8Array(256);
+        this.length = 0;
+    }
+
+    Writer.prototype = {
+        reserve: function(aCount) {
+            if (this.length + aCount <= this.bytes.length)
+                return;
+            let size = this.bytes.length * 2;
+            while (size < this.length + aCount)
+                size *= 2;
+            let bytes = new Uint8Array(size);
+            bytes.set(this.bytes.subarray(0, this.length));
+            this.bytes = bytes;
+        },
+
+        byte: function(aValue) {
+            this.reserve(1);
+            this.bytes[this.length++] = aValue;
+        },
+
+        head: function(aMajor, aValue) {
+            let major = aMajor << 5;
+            if (aValue < 24) {
+                this.byte(major | aValue);
+            } else if (aValue < 0x100) {
+                this.byte(major | 24);
+                this.byte(aValue);
+            } else if (aValue < 0x10000) {
+                this.byte(major | 25);
+                this.byte(aValue >>> 8);
+                this.byte(aValue & 0xff);
+            } else if (aValue < 0x100000000) {
+                this.byte(major | 26);
+                this.uint32(aValue);
+            } else {
+                this.byte(major | 27);
+                this.uint32(Math.floor(aValue / 0x100000000));
+                this.uint32(aValue % 0x100000000);
+            }
+        },
+
+        uint32: function(aValue) {
+            this.byte((aValue >>> 24) & 0xff);
+            this.byte((aValue >>> 16) & 0xff);
+            this.byte((aValue >>> 8) & 0xff);
+            this.byte(aValue & 0xff);
+        },
+
+        double: function(aValue) {
+            let view = new DataView(new ArrayBuffer(8));
+            view.setFloat64(0, aValue);
+            this.byte(0xfb);
+            for (let i = 0; i < 8; i++)
+                this.byte(view.getUint8(i));
+        },
+
+        text: function(aString) {
+            let utf8 = unescape(encodeURIComponent(aString));
+            this.head(3, utf8.length);
+            this.reserve(utf8.length);
+            for (let i = 0; i < utf8.length; i++)
+                this.bytes[this.length++] = utf8.charCodeAt(i);
+        },
+
+        value: function(aValue, aDepth) {
+            if (aDepth > kMaxDepth)
+                throw new Error("MessageCodec: payload nested too deep");
+            if (aValue === null || aValue === undefined) {
+                this.byte(0xf6);
+            } else if (aValue === false) {
+                this.byte(0xf4);
+            } else if (aValue === true) {
+                this.byte(0xf5);
+            } else if (typeof aValue == "number") {
+                if (Math.floor(aValue) === aValue && Math.abs(aValue) <= 9007199254740991 &&
+                    !(aValue === 0 && 1 / aValue < 0)) {
+                    if (aValue >= 0)
+                        this.head(0, aValue);
+                    else
+                        this.head(1, -1 - aValue);
+                } else {
+                    this.double(aValue);
+                }
+            } else if (typeof aValue == "string") {
+                this.text(aValue);
+            } else if (aValue instanceof ArrayBuffer || aValue instanceof Uint8Array) {
+                let bytes = new Uint8Array(aValue);
+                this.head(2, bytes.length);
+                this.reserve(bytes.length);
+                this.bytes.set(bytes, this.length);
+                this.length += bytes.length;
+            } else if (Array.isArray(aValue)) {
+                this.head(4, aValue.length);
+                for (let i = 0; i < aValue.length; i++)
+                    this.value(aValue[i], aDepth + 1);
+            } else if (typeof aValue.toJSON == "function") {
+                this.value(aValue.toJSON(), aDepth + 1);
+            } else {
+                let keys = Object.keys(aValue).filter(function(aKey) {
+                    return typeof aValue[aKey] != "function";
+                });
+                this.head(5, keys.length);
+                for (let i = 0; i < keys.length; i++) {
+                    this.text(keys[i]);
+                    this.value(aValue[keys[i]], aDepth + 1);
+                }
+            }
+        }
+    };
+
+    function Reader(aBytes) {
+        this.bytes = aBytes;
+        this.pos = 0;
+    }
+
+    Reader.prototype = {
+        byte: function() {
+            if (this.pos >= this.bytes.length)
+                throw new Error("MessageCodec: truncated payload");
+            return this.bytes[this.pos++];
+        },
+
+        uint: function(aInfo) {
+            if (aInfo < 24)
+                return aInfo;
+            let count = 1 << (aInfo - 24);
+            if (aInfo > 27)
+                throw new Error("MessageCodec: bad length");
+            let value = 0;
+            for (let i = 0; i < count; i++)
+                value = value * 256 + this.byte();
+            return value;
+        },
+
+        // Consumes the break ending an indefinite length item. Input running
+        // out before it is an error, not the end of the item.
+        atBreak: function() {
+            if (this.pos >= this.bytes.length)
+                throw new Error("MessageCodec: truncated payload");
+            if (this.bytes[this.pos] != 0xff)
+                return false;
+            this.pos++;
+            return true;
+        },
+
+        chunk: function(aMajor, aInfo) {
+            if (aInfo == 31) {
+                let parts = [];
+                while (!this.atBreak()) {
+                    let head = this.byte();
+                    if ((head >> 5) != aMajor || (head & 0x1f) == 31)
+                        throw new Error("MessageCodec: bad chunk");
+                    parts.push(this.chunk(aMajor, head & 0x1f));
+                }
+                let total = parts.reduce(function(aSum, aPart) { return aSum + aPart.length; }, 0);
+                let result = new Uint8Array(total);
+                let offset = 0;
+                parts.forEach(function(aPart) { result.set(aPart, offset); offset += aPart.length; });
+                return result;
+            }
+            let length = this.uint(aInfo);
+            if (this.pos + length > this.bytes.length)
+                throw new Error("MessageCodec: truncated payload");
+            let result = this.bytes.subarray(this.pos, this.pos + length);
+            this.pos += length;
+            return result;
+        },
+
+        text: function(aBytes) {
+            if (utf8Decoder)
+                return utf8Decoder.decode(aBytes);
+            // Building the string a byte at a time dominated decoding of
+            // text heavy payloads, convert in chunks instead
+            let parts = [];
+            let ascii = true;
+            for (let i = 0; i < aBytes.length; i += kCharChunk) {
+                let chunk = aBytes.subarray(i, i + kCharChunk);
+                parts.push(String.fromCharCode.apply(null, chunk));
+                for (let j = 0; ascii && j < chunk.length; j++)
+                    ascii = chunk[j] < 0x80;
+            }
+            let utf8 = parts.join("");
+            return ascii ? utf8 : decodeURIComponent(escape(utf8));
+        },
+
+        value: function(aDepth) {
+            if (aDepth > kMaxDepth)
+                throw new Error("MessageCodec: payload nested too deep");
+            let head = this.byte();
+            let major = head >> 5;
+            let info = head & 0x1f;
+            switch (major) {
+            case 0:
+                return this.uint(info);
+            case 1:
+                return -1 - this.uint(info);
+            case 2:
+                return this.chunk(2, info);
+            case 3:
+                return this.text(this.chunk(3, info));
+            case 4: {
+                let list = [];
+                if (info == 31) {
+                    while (!this.atBreak())
+                        list.push(this.value(aDepth + 1));
+                } else {
+                    let count = this.uint(info);
+                    for (let i = 0; i < count; i++)
+                        list.push(this.value(aDepth + 1));
+                }
+                return list;
+            }
+            case 5: {
+                let map = {};
+                if (info == 31) {
+                    while (!this.atBreak()) {
+                        let key = this.value(aDepth + 1);
+                        map[key] = this.value(aDepth + 1);
+                    }
+                } else {
+                    let count = this.uint(info);
+                    for (let i = 0; i < count; i++) {
+                        let key = this.value(aDepth + 1);
+                        map[key] = this.value(aDepth + 1);
+                    }
+                }
+                return map;
+            }
+            case 6:
+                this.uint(info);
+                return this.value(aDepth + 1);
+            }
+            switch (info) {
+            case 20: return false;
+            case 21: return true;
+            case 22: return null;
+            case 23: return undefined;
+            case 25: {
+                let half = this.uint(info);
+                let exponent = (half >> 10) & 0x1f;
+                let mantissa = half & 0x3ff;
+                let value;
+                if (exponent == 0)
+                    value = mantissa * Math.pow(2, -24);
+                else if (exponent != 31)
+                    value = (mantissa + 1024) * Math.pow(2, exponent - 25);
+                else
+                    value = mantissa == 0 ? Infinity : NaN;
+                return (half & 0x8000) ? -value : value;
+            }
+            case 26:
+            case 27: {
+                let size = info == 26 ? 4 : 8;
+                let view = new DataView(new ArrayBuffer(size));
+                for (let i = 0; i < size; i++)
+                    view.setUint8(i, this.byte());
+                return size == 4 ? view.getFloat32(0) : view.getFloat64(0);
+            }
+            }
+            if (info < 24)
+                return undefined;
+            throw new Error("MessageCodec: unsupported simple value " + info);
+        }
+    };
+
+    return {
+        // Name of the envelope used by views with messageBatching enabled
+        BATCH_MESSAGE: "embed:batch",
+
+        // Sent to the view to confirm which names are unpacked here
+        BATCH_READY: "embed:batch-ready",
+
+        // Splits batch envelopes and hands the contained messages named in
+        // aNames to aListener.receiveMessage() in the order they were sent,
+        // as if they had arrived on their own. The view batches only names
+        // confirmed this way, everything else keeps arriving unbatched.
+        addBatchListener: function(aListener, aNames) {
+            if (!batchListeners) {
+                batchListeners = {};
+                addMessageListener(this.BATCH_MESSAGE, function(aMessage) {
+                    let entries = aMessage.json;
+                    for (let i = 0; i < entries.length; i++) {
+                        let listener = batchListeners[entries[i].name];
+                        if (!listener)
+                            continue;
+                        listener.receiveMessage({
+                            name: entries[i].name,
+                            json: entries[i].data,
+                            target: aMessage.target,
+                            objects: aMessage.objects
+                        });
+                    }
+                });
+            }
+            for (let i = 0; i < aNames.length; i++)
+                batchListeners[aNames[i]] = aListener;
+            sendAsyncMessage(this.BATCH_READY, { names: aNames });
+        },
+
+        // Deferred sync message replies and the key of the ticket sent first
+        SYNC_REPLY: "embed:sync-reply",
+        SYNC_DEFERRED: "embed:deferred",
+
+        // sendSyncMessage() for names whose handlers may defer() the response.
+        // aCallback gets the reply, right away or once the view sends it
+        // later. Content is not blocked while the view waits for it.
+        sendSyncMessage: function(aName, aData, aCallback) {
+            let result = sendSyncMessage(aName, aData)[0];
+            if (!result || typeof result != "object" || !(this.SYNC_DEFERRED in result)) {
+                aCallback(result);
+                return;
+            }
+            if (!syncCallbacks) {
+                syncCallbacks = {};
+                addMessageListener(this.SYNC_REPLY, function(aMessage) {
+                    let callback = syncCallbacks[aMessage.json.id];
+                    if (callback) {
+                        delete syncCallbacks[aMessage.json.id];
+                        callback(aMessage.json.data);
+                    }
+                });
+            }
+            syncCallbacks[result[this.SYNC_DEFERRED]] = aCallback;
+        },
+
+        // Name of the message telling the view an attachment is no longer used
+        ATTACHMENT_RELEASE: "embed:attachment-release",
+
+        // Reads the shared memory behind an attachment descriptor created by
+        // QGraphicsMozView::createAttachment() into an ArrayBuffer. Call
+        // releaseAttachment() once done, also when the data is never read.
+        readAttachment: function(aDescriptor) {
+            let Cc = Components.classes;
+            let Ci = Components.interfaces;
+            let file = Cc["@mozilla.org/file/local;1"].createInstance(Ci.nsILocalFile);
+            file.initWithPath(aDescriptor.path);
+            let stream = Cc["@mozilla.org/network/file-input-stream;1"].createInstance(Ci.nsIFileInputStream);
+            stream.init(file, -1, 0, 0);
+            let binary = Cc["@mozilla.org/binaryinputstream;1"].createInstance(Ci.nsIBinaryInputStream);
+            binary.setInputStream(stream);
+            let buffer = new ArrayBuffer(aDescriptor.size);
+            try {
+                binary.readArrayBuffer(aDescriptor.size, buffer);
+            } finally {
+                binary.close();
+            }
+            return buffer;
+        },
+
+        releaseAttachment: function(aDescriptor) {
+            sendAsyncMessage(this.ATTACHMENT_RELEASE, { attachment: aDescriptor.attachment });
+        },
+
+        // Encodes aValue into the base64 CBOR string expected by the view
+        encode: function(aValue) {
+            let writer = new Writer();
+            writer.value(aValue, 0);
+            return toBase64(writer.bytes, writer.length);
+        },
+
+        // Decodes message data produced by QGraphicsMozView for "cbor" names
+        decode: function(aData) {
+            let reader = new Reader(fromBase64(aData));
+            let value = reader.value(0);
+            if (reader.pos != reader.bytes.length)
+                throw new Error("MessageCodec: trailing data");
+            return value;
+        }
+    };
+})();
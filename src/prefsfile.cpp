@@ -0,0 +1,293 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#define LOG_COMPONENT "PrefsFile"
+
+#include <QFile>
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+
+#include "prefsfile.h"
+#include "mozilla/embedlite/EmbedLog.h"
+
+namespace {
+
+class PrefsParser
+{
+public:
+    PrefsParser(const char* aData, qint64 aSize)
+        : mPos(aData)
+        , mEnd(aData + aSize)
+        , mLine(1)
+    {
+    }
+
+    int Parse(QVariantMap& aPrefs)
+    {
+        int count = 0;
+        while (SkipSpace()) {
+            QString name;
+            QVariant value;
+            int line = mLine;
+            if (ParseEntry(name, value)) {
+                aPrefs.insert(name, value);
+                count++;
+            } else {
+                LOGT("Malformed pref at line %i", line);
+                SkipStatement();
+            }
+        }
+        return count;
+    }
+
+private:
+    // Skips whitespace and comments, false at the end of data
+    bool SkipSpace()
+    {
+        while (mPos < mEnd) {
+            char c = *mPos;
+            if (c == '\n') {
+                mLine++;
+                mPos++;
+            } else if (c == ' ' || c == '\t' || c == '\r') {
+                mPos++;
+            } else if (c == '#' || (c == '/' && mPos + 1 < mEnd && mPos[1] == '/')) {
+                while (mPos < mEnd && *mPos != '\n') {
+                    mPos++;
+                }
+            } else if (c == '/' && mPos + 1 < mEnd && mPos[1] == '*') {
+                mPos += 2;
+                while (mPos < mEnd && !(*mPos == '*' && mPos + 1 < mEnd && mPos[1] == '/')) {
+                    if (*mPos == '\n') {
+                        mLine++;
+                    }
+                    mPos++;
+                }
+                mPos = qMin(mPos + 2, mEnd);
+            } else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void SkipStatement()
+    {
+        while (mPos < mEnd && *mPos != ';' && *mPos != '\n') {
+            mPos++;
+        }
+        if (mPos < mEnd) {
+            mPos++;
+        }
+    }
+
+    bool Expect(char aChar)
+    {
+        if (!SkipSpace() || *mPos != aChar) {
+            return false;
+        }
+        mPos++;
+        return true;
+    }
+
+    bool Keyword(const char* aWord)
+    {
+        int length = strlen(aWord);
+        if (mEnd - mPos < length || strncmp(mPos, aWord, length) != 0) {
+            return false;
+        }
+        // "pref" must not match the start of "prefix"
+        const char* next = mPos + length;
+        if (next < mEnd && (isalnum(uchar(*next)) || *next == '_')) {
+            return false;
+        }
+        mPos = next;
+        return true;
+    }
+
+    bool ParseEntry(QString& aName, QVariant& aValue)
+    {
+        if (!Keyword("user_pref") && !Keyword("sticky_pref") && !Keyword("pref")) {
+            return false;
+        }
+        QByteArray name;
+        if (!Expect('(') || !SkipSpace() || !ParseString(name) || !Expect(',') ||
+            !SkipSpace() || !ParseValue(aValue) || !Expect(')') || !Expect(';')) {
+            return false;
+        }
+        aName = QString::fromUtf8(name.constData(), name.size());
+        return true;
+    }
+
+    bool ParseValue(QVariant& aValue)
+    {
+        if (*mPos == '"' || *mPos == '\'') {
+            QByteArray string;
+            if (!ParseString(string)) {
+                return false;
+            }
+            aValue = QString::fromUtf8(string.constData(), string.size());
+            return true;
+        }
+        if (Keyword("true")) {
+            aValue = true;
+            return true;
+        }
+        if (Keyword("false")) {
+            aValue = false;
+            return true;
+        }
+        bool negative = false;
+        if (*mPos == '-' || *mPos == '+') {
+            negative = *mPos == '-';
+            mPos++;
+        }
+        if (mPos == mEnd || *mPos < '0' || *mPos > '9') {
+            return false;
+        }
+        qint64 number = 0;
+        while (mPos < mEnd && *mPos >= '0' && *mPos <= '9') {
+            number = number * 10 + (*mPos - '0');
+            if (number > Q_INT64_C(0x80000000)) {
+                return false;
+            }
+            mPos++;
+        }
+        number = negative ? -number : number;
+        if (number > INT_MAX) {
+            return false;
+        }
+        aValue = int(number);
+        return true;
+    }
+
+    static int HexValue(char aChar)
+    {
+        if (aChar >= '0' && aChar <= '9') return aChar - '0';
+        if (aChar >= 'a' && aChar <= 'f') return aChar - 'a' + 10;
+        if (aChar >= 'A' && aChar <= 'F') return aChar - 'A' + 10;
+        return -1;
+    }
+
+    bool ParseHex(int aDigits, uint* aValue)
+    {
+        *aValue = 0;
+        for (int i = 0; i < aDigits; ++i) {
+            int digit = mPos < mEnd ? HexValue(*mPos) : -1;
+            if (digit < 0) {
+                return false;
+            }
+            *aValue = (*aValue << 4) | digit;
+            mPos++;
+        }
+        return true;
+    }
+
+    // Keeps the UTF-8 bytes as they are, only escapes are decoded
+    bool ParseString(QByteArray& aOut)
+    {
+        char quote = *mPos;
+        if (quote != '"' && quote != '\'') {
+            return false;
+        }
+        mPos++;
+        const char* start = mPos;
+        // Fast path, most strings have no escapes
+        while (mPos < mEnd && *mPos != quote && *mPos != '\\' && *mPos != '\n') {
+            mPos++;
+        }
+        aOut = QByteArray(start, mPos - start);
+        while (mPos < mEnd && *mPos != quote) {
+            char c = *mPos++;
+            if (c == '\n') {
+                return false;
+            }
+            if (c != '\\') {
+                aOut.append(c);
+                continue;
+            }
+            if (mPos == mEnd) {
+                return false;
+            }
+            c = *mPos++;
+            uint code;
+            switch (c) {
+            case 'n': aOut.append('\n'); break;
+            case 'r': aOut.append('\r'); break;
+            case 't': aOut.append('\t'); break;
+            case 'x':
+                if (!ParseHex(2, &code)) {
+                    return false;
+                }
+                aOut.append(QString(QChar(code)).toUtf8());
+                break;
+            case 'u': {
+                if (!ParseHex(4, &code)) {
+                    return false;
+                }
+                QString text(QChar(code));
+                // Characters outside the BMP come as a \uD8xx\uDCxx pair
+                uint low;
+                if (QChar::isHighSurrogate(code) && mEnd - mPos >= 6 &&
+                    mPos[0] == '\\' && mPos[1] == 'u') {
+                    const char* pair = mPos;
+                    mPos += 2;
+                    if (ParseHex(4, &low) && QChar::isLowSurrogate(low)) {
+                        text.append(QChar(low));
+                    } else {
+                        mPos = pair;
+                    }
+                }
+                aOut.append(text.toUtf8());
+                break;
+            }
+            default:
+                // \\, \" and \' stand for themselves
+                aOut.append(c);
+            }
+        }
+        if (mPos == mEnd) {
+            return false;
+        }
+        mPos++;
+        return true;
+    }
+
+    const char* mPos;
+    const char* mEnd;
+    int mLine;
+};
+
+} // namespace
+
+int PrefsFile::Load(const QString& aPath, QVariantMap& aPrefs)
+{
+    QFile file(aPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        LOGT("Failed to open %s: %s", aPath.toUtf8().data(), file.errorString().toUtf8().data());
+        return -1;
+    }
+    qint64 size = file.size();
+    if (size == 0) {
+        return 0;
+    }
+    // Mapping spares the copy into a buffer, fall back to reading if not mappable
+    const char* data = reinterpret_cast<const char*>(file.map(0, size));
+    if (data) {
+        int count = Parse(data, size, aPrefs);
+        file.unmap((uchar*)data);
+        return count;
+    }
+    QByteArray contents = file.readAll();
+    return Parse(contents.constData(), contents.size(), aPrefs);
+}
+
+int PrefsFile::Parse(const char* aData, qint64 aSize, QVariantMap& aPrefs)
+{
+    PrefsParser parser(aData, aSize);
+    return parser.Parse(aPrefs);
+}
@@ -0,0 +1,27 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef PREFSFILE_H
+#define PREFSFILE_H
+
+#include <QString>
+#include <QVariantMap>
+
+/*!
+ * Reader for Gecko prefs.js style files: pref(), user_pref() and
+ * sticky_pref() calls with string, integer or boolean values. The file
+ * is memory mapped and parsed in place.
+ */
+class PrefsFile
+{
+public:
+    // Adds the prefs of aPath to aPrefs, returns the number read or -1 if
+    // the file can't be read. Malformed entries are skipped.
+    static int Load(const QString& aPath, QVariantMap& aPrefs);
+    static int Parse(const char* aData, qint64 aSize, QVariantMap& aPrefs);
+};
+
+#endif
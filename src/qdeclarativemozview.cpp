@@ -35,6 +35,7 @@ QDeclarativeMozView::QDeclarativeMozView(QDeclarativeItem* parent)
     static bool Initialized = false;
     if (!Initialized) {
         qmlRegisterType<QSyncMessageResponse>("QtMozilla", 1, 0, "QSyncMessageResponse");
+        qmlRegisterType<QMozMessagePayload>();
         Initialized = true;
     }
 }
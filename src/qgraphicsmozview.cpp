@@ -9,19 +9,21 @@
 #include <QStyleOptionGraphicsItem>
 #include <QGraphicsSceneMouseEvent>
 #include <QTimer>
+#include <QMutexLocker>
 #include <QtOpenGL/QGLContext>
 #if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
 #include <QInputContext>
-#include <qjson/serializer.h>
-#include <qjson/parser.h>
-#else
-#include <QJsonDocument>
-#include <QJsonParseError>
 #endif
 #include "EmbedQtKeyUtils.h"
 
 #include "qgraphicsmozview.h"
 #include "qmozcontext.h"
+#include "renderworker.h"
+#include "shmbackbuffer.h"
+#include "framescheduler.h"
+#include "viewpool.h"
+#include "messagecodec.h"
+#include "shmattachment.h"
 #include "InputData.h"
 #include "mozilla/embedlite/EmbedLog.h"
 #include "mozilla/embedlite/EmbedLiteApp.h"
@@ -31,6 +33,8 @@
 using namespace mozilla;
 using namespace mozilla::embedlite;
 
+static const int kScrollSettleDelay = 150;
+
 QGraphicsMozView::QGraphicsMozView(QGraphicsItem* parent)
     : QGraphicsWidget(parent)
     , d(new QGraphicsMozViewPrivate(this))
@@ -49,6 +53,11 @@ QGraphicsMozView::QGraphicsMozView(QGraphicsItem* parent)
     setFlag(QGraphicsItem::ItemIsFocusable, true);
     setInputMethodHints(Qt::ImhPreferLowercase);
 
+    d->mScrollSettleTimer = new QTimer(this);
+    d->mScrollSettleTimer->setSingleShot(true);
+    d->mScrollSettleTimer->setInterval(kScrollSettleDelay);
+    connect(d->mScrollSettleTimer, SIGNAL(timeout()), this, SLOT(onScrollSettled()));
+
     d->mContext = QMozContext::GetInstance();
     if (!d->mContext->initialized()) {
         connect(d->mContext, SIGNAL(onInitialized()), this, SLOT(onInitialized()));
@@ -69,6 +78,7 @@ QGraphicsMozView::setParentID(unsigned aParentID)
 
 QGraphicsMozView::~QGraphicsMozView()
 {
+    d->StopRenderWorker();
     d->mContext->GetApp()->DestroyView(d->mView);
     if (d->mView) {
         d->mView->SetListener(NULL);
@@ -81,8 +91,19 @@ QGraphicsMozView::onInitialized()
 {
     LOGT("mParentID:%u", mParentID);
     if (!d->mView) {
-        d->mView = d->mContext->GetApp()->CreateView(mParentID);
+        bool initialized = false;
+        // Pooled views have no parent, popups still get their own
+        if (!mParentID) {
+            d->mView = d->mContext->GetViewPool()->take(&initialized);
+        }
+        if (!d->mView) {
+            d->mView = d->mContext->GetApp()->CreateView(mParentID);
+        }
         d->mView->SetListener(d);
+        d->mContext->markStartupPhase("first-view-created");
+        if (initialized) {
+            d->ViewInitialized();
+        }
     }
 }
 
@@ -127,6 +148,8 @@ QGraphicsMozView::paint(QPainter* painter, const QStyleOptionGraphicsItem* opt,
         }
     }
 
+    d->mContext->GetFrameScheduler()->framePresented(d);
+
     QRect r = opt ? opt->exposedRect.toRect() : boundingRect().toRect();
     if (d->mViewInitialized) {
         QMatrix affine = painter->transform().toAffine();
@@ -134,6 +157,7 @@ QGraphicsMozView::paint(QPainter* painter, const QStyleOptionGraphicsItem* opt,
         bool changedState = d->mLastIsGoodRotation != matr.PreservesAxisAlignedRectangles();
         d->mLastIsGoodRotation = matr.PreservesAxisAlignedRectangles();
         if (d->mContext->GetApp()->IsAccelerated()) {
+            QMutexLocker lock(d->ViewMutex());
             d->mView->SetGLViewTransform(matr);
             d->mView->SetViewClipping(0, 0, d->mSize.width(), d->mSize.height());
             if (changedState) {
@@ -144,24 +168,97 @@ QGraphicsMozView::paint(QPainter* painter, const QStyleOptionGraphicsItem* opt,
                 QRect eraseRect = painter->transform().isRotating() ? affine.mapRect(r) : r;
                 painter->beginNativePainting();
                 EraseBackgroundGL(painter, eraseRect);
-                bool retval = d->mView->RenderGL();
+                bool retval;
+                {
+                    LatencyScope scope(d->mRenderGLTime);
+                    retval = d->mView->RenderGL();
+                }
                 painter->endNativePainting();
                 if (!retval) {
                     EraseBackgroundGL(painter, eraseRect);
                 }
             }
+        } else if (d->mRenderWorker) {
+            d->mRenderWorker->setImageFormat(d->BackBufferFormat(painter->device()));
+            // Never wait for Gecko here, paint whatever frame completed last
+            d->mRenderWorker->takeFrame();
+            const QImage& frame = d->mRenderWorker->frontBuffer();
+            if (!frame.rect().contains(r)) {
+                painter->fillRect(r, d->mBgColor);
+            }
+            QRect exposed = r.intersected(frame.rect());
+            if (!exposed.isEmpty()) {
+                painter->drawImage(exposed, frame, exposed);
+            }
         } else {
-            if (d->mTempBufferImage.isNull() || d->mTempBufferImage.width() != r.width() || d->mTempBufferImage.height() != r.height()) {
-                d->mTempBufferImage = QImage(r.size(), QImage::Format_RGB16);
+            if (d->mSize.isEmpty()) {
+                painter->fillRect(r, d->mBgColor);
+                return;
             }
-            {
-                QPainter imgPainter(&d->mTempBufferImage);
-                imgPainter.fillRect(r, d->mBgColor);
+            // Back buffer keeps the last rendered frame, so exposures coming from
+            // the scene only (overlapping items, scene scrolling) are served from it
+            QImage::Format format = d->BackBufferFormat(painter->device());
+            if (d->mTempBufferImage.isNull() || d->mTempBufferImage.size() != d->mSize ||
+                d->mTempBufferImage.format() != format) {
+                d->mTempBufferImage = QImage();
+                if (d->mShmBuffer) {
+                    d->mTempBufferImage = d->mShmBuffer->create(d->mSize, format);
+                }
+                if (d->mTempBufferImage.isNull()) {
+                    d->mTempBufferImage = QImage(d->mSize, format);
+                }
+                d->mDirtyRegion = QRegion(d->mTempBufferImage.rect());
+            }
+            if (!d->mDirtyRegion.isEmpty()) {
+                if (d->mShmBuffer) {
+                    d->mShmBuffer->sync();
+                }
+                {
+                    QPainter imgPainter(&d->mTempBufferImage);
+                    imgPainter.setClipRegion(d->mDirtyRegion);
+                    imgPainter.setCompositionMode(QPainter::CompositionMode_Source);
+                    imgPainter.fillRect(d->mTempBufferImage.rect(), d->mBgColor);
+                }
+                {
+                    LatencyScope scope(d->mRenderToImageTime);
+                    d->mView->RenderToImage(d->mTempBufferImage.bits(), d->mTempBufferImage.width(),
+                                            d->mTempBufferImage.height(), d->mTempBufferImage.bytesPerLine(),
+                                            d->mTempBufferImage.depth());
+                }
+                d->mDirtyRegion = QRegion();
+                if (d->mTiles.isEnabled()) {
+                    if (d->mTilesShown && !d->mTilesStale &&
+                        !d->mTiles.matches(d->mTempBufferImage, d->mTileOffset)) {
+                        // Composed frames showed fixed or animated content in
+                        // the wrong place, stop composing for this page
+                        d->mTilesBlocked = true;
+                        d->mTilesStale = true;
+                    }
+                    d->mTilesShown = false;
+                    if (d->mTilesStale) {
+                        d->mTiles.clear();
+                        d->mTilesStale = false;
+                    }
+                    d->mTiles.update(d->mTempBufferImage, d->mTileOffset);
+                }
+                d->mScrollOnlyFrame = false;
+            } else if (d->mScrollOnlyFrame) {
+                if (d->mShmBuffer) {
+                    d->mShmBuffer->sync();
+                }
+                d->mTiles.paint(d->mTempBufferImage, d->mTileOffset, d->mBgColor);
+                d->mScrollOnlyFrame = false;
+                d->mTilesShown = true;
+                // Content may have changed under the cached tiles, take a
+                // real frame once scrolling stops. Restarted by every
+                // composed frame, so it fires after the last one.
+                d->mScrollSettleTimer->start();
+            }
+            QRect exposed = r.intersected(d->mTempBufferImage.rect());
+            if (!exposed.isEmpty() &&
+                !(d->mShmBuffer && d->mShmBuffer->isValid() && d->mShmBuffer->present(painter, exposed))) {
+                painter->drawImage(exposed, d->mTempBufferImage, exposed);
             }
-            d->mView->RenderToImage(d->mTempBufferImage.bits(), d->mTempBufferImage.width(),
-                                    d->mTempBufferImage.height(), d->mTempBufferImage.bytesPerLine(),
-                                    d->mTempBufferImage.depth());
-            painter->drawImage(QPoint(0, 0), d->mTempBufferImage);
         }
     } else {
         painter->fillRect(r, Qt::white);
@@ -229,15 +326,284 @@ void QGraphicsMozView::sendAsyncMessage(const QString& name, const QVariant& var
     if (!d->mViewInitialized)
         return;
 
-#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
-    QJson::Serializer serializer;
-    QByteArray array = serializer.serialize(variant);
-#else
-    QJsonDocument doc = QJsonDocument::fromVariant(variant);
-    QByteArray array = doc.toJson();
-#endif
+    if (d->mLowPriorityMessages.contains(name)) {
+        LowPriorityMessage queued;
+        queued.mName = name;
+        queued.mData = variant;
+        queued.mQueuedAt = d->mLaneClock.elapsed();
+        d->mLowOutgoing.enqueue(queued);
+        d->mLowMaxDepth = qMax(d->mLowMaxDepth, d->mLowOutgoing.size());
+        d->ScheduleLowPriorityDrain();
+        return;
+    }
+
+    d->mHighSent++;
+    d->PostAsyncMessage(name, variant);
+}
+
+void QGraphicsMozView::setMessagePriority(const QString& name, const QString& priority)
+{
+    LOGT("name:%s, priority:%s", name.toUtf8().data(), priority.toUtf8().data());
+    if (priority == QLatin1String("low")) {
+        d->mLowPriorityMessages.insert(name);
+    } else if (d->mLowPriorityMessages.remove(name)) {
+        // Later messages skip the queue, so send what it holds of name now
+        d->FlushLowPriorityMessages(name);
+    }
+}
+
+QString QGraphicsMozView::messagePriority(const QString& name) const
+{
+    return d->mLowPriorityMessages.contains(name) ? QLatin1String("low") : QLatin1String("high");
+}
+
+QVariantMap QGraphicsMozView::messageLaneStatistics() const
+{
+    QVariantMap high;
+    high.insert("sent", d->mHighSent);
+    high.insert("received", d->mHighReceived);
+
+    QVariantMap low;
+    low.insert("sent", d->mLowSent);
+    low.insert("received", d->mLowReceived);
+    low.insert("outgoingDepth", d->mLowOutgoing.size());
+    low.insert("incomingDepth", d->mLowIncoming.size());
+    low.insert("maxDepth", d->mLowMaxDepth);
+    low.insert("forcedByAge", d->mLowForcedByAge);
+
+    QVariantMap stats;
+    stats.insert("high", high);
+    stats.insert("low", low);
+    return stats;
+}
+
+void QGraphicsMozView::drainLowPriorityMessages()
+{
+    d->DrainLowPriorityMessages();
+}
+
+void QGraphicsMozView::onSyncResponseCompleted()
+{
+    d->SendSyncReply(qobject_cast<QSyncMessageResponse*>(sender()), false);
+}
+
+void QGraphicsMozView::onSyncResponseTimeout()
+{
+    // Timer is a child of the response
+    d->SendSyncReply(qobject_cast<QSyncMessageResponse*>(sender()->parent()), true);
+}
+
+bool QGraphicsMozView::messageBatching() const
+{
+    return d->mMessageBatching;
+}
+
+void QGraphicsMozView::setMessageBatching(bool aBatching)
+{
+    if (d->mMessageBatching == aBatching)
+        return;
+
+    d->mMessageBatching = aBatching;
+    if (!aBatching) {
+        // Keep ordering with messages sent directly from now on
+        d->FlushMessageBatch();
+    }
+}
+
+void QGraphicsMozView::flushMessageBatch()
+{
+    d->FlushMessageBatch();
+}
+
+void QGraphicsMozView::setMessageEncoding(const QString& name, const QString& encoding)
+{
+    LOGT("name:%s, encoding:%s", name.toUtf8().data(), encoding.toUtf8().data());
+    if (encoding == QLatin1String("cbor")) {
+        d->mBinaryMessages.insert(name);
+    } else {
+        if (encoding != QLatin1String("json")) {
+            LOGT("unknown encoding, falling back to json");
+        }
+        d->mBinaryMessages.remove(name);
+    }
+}
+
+QString QGraphicsMozView::messageEncoding(const QString& name) const
+{
+    return d->mBinaryMessages.contains(name) ? QLatin1String("cbor") : QLatin1String("json");
+}
+
+QVariant QGraphicsMozView::createAttachment(const QByteArray& data)
+{
+    if (!d->mViewInitialized)
+        return QVariant();
+
+    return d->AddAttachment(ShmAttachment::Create(data));
+}
+
+QVariant QGraphicsMozView::createImageAttachment(const QImage& image)
+{
+    if (!d->mViewInitialized || image.isNull())
+        return QVariant();
+
+    return d->AddAttachment(ShmAttachment::Create(image));
+}
+
+void QGraphicsMozView::releaseAttachment(const QVariant& descriptor)
+{
+    d->ReleaseAttachment(descriptor.toMap().value("attachment").toUInt(), ShmAttachment::Sender);
+}
+
+bool QGraphicsMozView::registerMessageHandler(const QString& name, QObject* receiver, const QString& method)
+{
+    if (!receiver || name.isEmpty()) {
+        return false;
+    }
+
+    const QMetaObject* meta = receiver->metaObject();
+    QByteArray base = method.toLatin1();
+    MessageHandler handler;
+    handler.mReceiver = receiver;
+    handler.mVariantName = true;
+    int index = meta->indexOfMethod(QMetaObject::normalizedSignature(base + "(QVariant,QVariant)"));
+    if (index < 0) {
+        handler.mVariantName = false;
+        index = meta->indexOfMethod(QMetaObject::normalizedSignature(base + "(QString,QVariant)"));
+    }
+    if (index < 0) {
+        LOGT("no method %s(message, data) in %s", base.constData(), meta->className());
+        return false;
+    }
+    handler.mMethod = meta->method(index);
+
+    QList<MessageHandler>& handlers = d->mMessageHandlers[name];
+    bool firstForName = handlers.isEmpty();
+    handlers.append(handler);
+    connect(receiver, SIGNAL(destroyed(QObject*)), this, SLOT(onMessageHandlerDestroyed(QObject*)), Qt::UniqueConnection);
+
+    LOGT("name:%s, method:%s", name.toUtf8().data(), base.constData());
+    if (firstForName && d->mViewInitialized) {
+        addMessageListener(name);
+    }
+    return true;
+}
+
+void QGraphicsMozView::unregisterMessageHandler(const QString& name, QObject* receiver)
+{
+    QHash<QString, QList<MessageHandler> >::iterator it = d->mMessageHandlers.find(name);
+    if (it == d->mMessageHandlers.end()) {
+        return;
+    }
+    QList<MessageHandler>::iterator handler = it->begin();
+    while (handler != it->end()) {
+        if (handler->mReceiver == receiver) {
+            handler = it->erase(handler);
+        } else {
+            ++handler;
+        }
+    }
+    // Gecko has no way to remove a message listener, messages for the name
+    // are dropped in RecvAsyncMessage when nothing else listens
+    if (it->isEmpty()) {
+        d->mMessageHandlers.erase(it);
+    }
+}
+
+void QGraphicsMozView::onMessageHandlerDestroyed(QObject* receiver)
+{
+    // The guard is already cleared when destroyed() fires, so drop every
+    // entry without a receiver rather than matching the pointer
+    QHash<QString, QList<MessageHandler> >::iterator it = d->mMessageHandlers.begin();
+    while (it != d->mMessageHandlers.end()) {
+        QList<MessageHandler>::iterator handler = it->begin();
+        while (handler != it->end()) {
+            if (!handler->mReceiver || handler->mReceiver == receiver) {
+                handler = it->erase(handler);
+            } else {
+                ++handler;
+            }
+        }
+        if (it->isEmpty()) {
+            it = d->mMessageHandlers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QMozMessagePayload::QMozMessagePayload(const QChar* aData, int aLength, bool aBinary, QObject* parent)
+  : QObject(parent)
+  , mRaw(aData)
+  , mLength(aLength)
+  , mBinary(aBinary)
+  , mActive(false)
+  , mExpired(false)
+  , mDecoded(false)
+  , mValid(false)
+{
+}
+
+void QMozMessagePayload::reset(const QChar* aData, int aLength, bool aBinary)
+{
+    mRaw = aData;
+    mLength = aLength;
+    mBinary = aBinary;
+    mActive = true;
+    mExpired = false;
+    mDecoded = false;
+    mValid = false;
+    mData = QVariant();
+}
+
+void QMozMessagePayload::expire()
+{
+    mRaw = NULL;
+    mLength = 0;
+    mActive = false;
+    mExpired = true;
+    mDecoded = true;
+    mValid = false;
+    mData = QVariant();
+}
+
+void QMozMessagePayload::decode() const
+{
+    if (mDecoded) {
+        return;
+    }
+    mDecoded = true;
+    if (mBinary) {
+        mData = MessageCodec::DecodeBinaryPayload(mRaw, mLength, &mValid);
+        if (!mValid) {
+            LOGT("invalid binary payload");
+        }
+    } else {
+        QString error;
+        mData = MessageCodec::DecodeJson(mRaw, mLength, &mValid, &error);
+        if (!mValid) {
+            LOGT("parse: err:%s", error.toUtf8().data());
+        }
+    }
+}
+
+QVariant QMozMessagePayload::data() const
+{
+    Q_ASSERT_X(!mExpired, "QMozMessagePayload", "used after delivery, connect recvAsyncMessagePayload directly");
+    decode();
+    return mData;
+}
 
-    d->mView->SendAsyncMessage((const PRUnichar*)name.constData(), NS_ConvertUTF8toUTF16(array.constData()).get());
+QString QMozMessagePayload::rawData() const
+{
+    Q_ASSERT_X(!mExpired, "QMozMessagePayload", "used after delivery, connect recvAsyncMessagePayload directly");
+    return QString(mRaw, mLength);
+}
+
+bool QMozMessagePayload::isValid() const
+{
+    Q_ASSERT_X(!mExpired, "QMozMessagePayload", "used after delivery, connect recvAsyncMessagePayload directly");
+    decode();
+    return mValid;
 }
 
 QPointF QGraphicsMozView::scrollableOffset() const
@@ -250,6 +616,137 @@ bool QGraphicsMozView::isPainted() const
     return d->mIsPainted;
 }
 
+bool QGraphicsMozView::threadedRendering() const
+{
+    return d->mThreadedRendering;
+}
+
+void QGraphicsMozView::setThreadedRendering(bool aThreaded)
+{
+    if (d->mThreadedRendering == aThreaded)
+        return;
+
+    d->mThreadedRendering = aThreaded;
+    if (aThreaded) {
+        d->StartRenderWorker();
+    } else {
+        d->StopRenderWorker();
+        d->AddDirtyRect(QRect(QPoint(0, 0), d->mSize));
+    }
+}
+
+int QGraphicsMozView::framesProduced() const
+{
+    return d->mRenderWorker ? d->mRenderWorker->framesProduced() : 0;
+}
+
+int QGraphicsMozView::framesPresented() const
+{
+    return d->mRenderWorker ? d->mRenderWorker->framesPresented() : 0;
+}
+
+int QGraphicsMozView::renderFormat() const
+{
+    return d->mRenderFormat;
+}
+
+void QGraphicsMozView::setRenderFormat(int aFormat)
+{
+    switch (aFormat) {
+    case QImage::Format_Invalid:
+    case QImage::Format_RGB16:
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        break;
+    default:
+        LOGT("Unsupported render format: %i", aFormat);
+        return;
+    }
+    if (d->mRenderFormat == aFormat)
+        return;
+
+    d->mRenderFormat = static_cast<QImage::Format>(aFormat);
+    d->AddDirtyRect(QRect(QPoint(0, 0), d->mSize));
+}
+
+int QGraphicsMozView::tileCacheSize() const
+{
+    return d->mTiles.maxBytes();
+}
+
+void QGraphicsMozView::setTileCacheSize(int aBytes)
+{
+    d->mTiles.setMaxBytes(aBytes);
+}
+
+int QGraphicsMozView::tileCacheHits() const
+{
+    return d->mTiles.hits();
+}
+
+int QGraphicsMozView::tileCacheMisses() const
+{
+    return d->mTiles.misses();
+}
+
+QVariantMap QGraphicsMozView::renderStatistics() const
+{
+    QVariantMap stats;
+    stats.insert("RenderGL", d->mRenderGLTime.toVariantMap());
+    stats.insert("RenderToImage", d->mRenderToImageTime.toVariantMap());
+    return stats;
+}
+
+QVariantMap QGraphicsMozView::syncMessageStatistics() const
+{
+    QVariantMap stats;
+    QHash<QString, LatencyHistogram*>::const_iterator it = d->mSyncMessageTime.constBegin();
+    for (; it != d->mSyncMessageTime.constEnd(); ++it) {
+        QVariantMap entry = it.value()->toVariantMap();
+        entry.insert("timeouts", d->mSyncMessageTimeouts.value(it.key()));
+        stats.insert(it.key(), entry);
+    }
+    return stats;
+}
+
+void QGraphicsMozView::dumpSyncMessageStatistics()
+{
+    QHash<QString, LatencyHistogram*>::const_iterator it = d->mSyncMessageTime.constBegin();
+    for (; it != d->mSyncMessageTime.constEnd(); ++it) {
+        QByteArray name = QString("View %1 sync %2 (%3 timeouts)").arg(uniqueID()).arg(it.key())
+                              .arg(d->mSyncMessageTimeouts.value(it.key())).toUtf8();
+        it.value()->dump(name.constData());
+    }
+}
+
+void QGraphicsMozView::dumpRenderStatistics()
+{
+    QByteArray prefix = QString("View %1").arg(uniqueID()).toUtf8();
+    d->mRenderGLTime.dump((prefix + " RenderGL").constData());
+    d->mRenderToImageTime.dump((prefix + " RenderToImage").constData());
+}
+
+bool QGraphicsMozView::sharedMemoryBuffer() const
+{
+    return d->mShmBuffer != NULL;
+}
+
+void QGraphicsMozView::setSharedMemoryBuffer(bool aShared)
+{
+    if (sharedMemoryBuffer() == aShared)
+        return;
+
+    // Buffer is reallocated on next paint
+    d->mTempBufferImage = QImage();
+    if (aShared) {
+        d->mShmBuffer = new ShmBackBuffer();
+    } else {
+        delete d->mShmBuffer;
+        d->mShmBuffer = NULL;
+    }
+    d->AddDirtyRect(QRect(QPoint(0, 0), d->mSize));
+}
+
 float QGraphicsMozView::resolution() const
 {
     return d->mContentResolution;
@@ -357,6 +854,7 @@ void QGraphicsMozView::onDisplayEntered()
     if (!d->mView) {
         return;
     }
+    d->mDisplayActive = true;
     d->mView->SetIsActive(true);
     d->mView->ResumeTimeouts();
 }
@@ -366,10 +864,21 @@ void QGraphicsMozView::onDisplayExited()
     if (!d->mView) {
         return;
     }
+    d->mDisplayActive = false;
     d->mView->SetIsActive(false);
     d->mView->SuspendTimeouts();
 }
 
+void QGraphicsMozView::onFrameReady()
+{
+    update();
+}
+
+void QGraphicsMozView::onScrollSettled()
+{
+    d->AddDirtyRect(QRect(QPoint(0, 0), d->mSize));
+}
+
 void QGraphicsMozView::mouseMoveEvent(QGraphicsSceneMouseEvent* e)
 {
     if (d->mViewInitialized && !d->mPendingTouchEvent) {
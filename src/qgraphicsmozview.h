@@ -10,29 +10,102 @@
 #include <QGraphicsView>
 #include <QGraphicsWidget>
 #include <QUrl>
+#include <QImage>
 
 class QMozContext;
 class QSyncMessage;
 class QGraphicsMozViewPrivate;
 
+// Handlers of recvSyncMessage either set message right away, or call defer()
+// and complete() the response later. Content is answered right away in both
+// cases: for a deferred response it gets a ticket, and the value follows as an
+// async message once complete() is called, or the default value once the
+// timeout passes. Frame scripts receive it with MessageCodec.sendSyncMessage().
+// The view owns the response and deletes it after replying, keep it in a
+// QPointer to complete it later.
 class QSyncMessageResponse : public QObject {
     Q_OBJECT
     Q_PROPERTY(QVariant message READ getMessage WRITE setMessage FINAL)
+    Q_PROPERTY(bool deferred READ isDeferred FINAL)
+    Q_PROPERTY(bool completed READ isCompleted NOTIFY completedChanged FINAL)
 
 public:
-    QSyncMessageResponse(QObject* parent = 0) : QObject(parent) {}
-    QSyncMessageResponse(const QSyncMessageResponse& aMsg) : QObject(NULL) { mMessage = aMsg.mMessage; }
+    QSyncMessageResponse(QObject* parent = 0)
+      : QObject(parent), mDeferred(false), mCompleted(false), mTimeout(0) {}
+    QSyncMessageResponse(const QSyncMessageResponse& aMsg)
+      : QObject(NULL), mMessage(aMsg.mMessage), mDeferred(false), mCompleted(false), mTimeout(0) {}
     virtual ~QSyncMessageResponse() {}
 
     QVariant getMessage() const { return mMessage; }
     void setMessage(const QVariant& msg) { mMessage = msg; }
+    bool isDeferred() const { return mDeferred; }
+    bool isCompleted() const { return mCompleted; }
+    int timeout() const { return mTimeout; }
+
+    Q_INVOKABLE void defer(int timeout = 1000, const QVariant& defaultValue = QVariant()) {
+        if (mCompleted)
+            return;
+        mDeferred = true;
+        mTimeout = timeout;
+        mMessage = defaultValue;
+    }
+    Q_INVOKABLE void complete(const QVariant& msg) {
+        if (mCompleted)
+            return;
+        mMessage = msg;
+        mCompleted = true;
+        Q_EMIT completedChanged();
+    }
+
+Q_SIGNALS:
+    void completedChanged();
 
 private:
     QVariant mMessage;
+    bool mDeferred;
+    bool mCompleted;
+    int mTimeout;
 };
 
 Q_DECLARE_METATYPE(QSyncMessageResponse)
 
+// Async message data as received from content, decoded on first access.
+// Only valid while the recvAsyncMessagePayload handler runs, so only direct
+// connections are supported. Afterwards it is expired: data() is invalid,
+// rawData() empty, and debug builds assert.
+class QMozMessagePayload : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(QVariant data READ data FINAL)
+    Q_PROPERTY(QString rawData READ rawData FINAL)
+    Q_PROPERTY(bool valid READ isValid FINAL)
+
+public:
+    QMozMessagePayload(const QChar* aData, int aLength, bool aBinary, QObject* parent = 0);
+    virtual ~QMozMessagePayload() {}
+
+    QVariant data() const;
+    QString rawData() const;
+    bool isValid() const;
+    bool isDecoded() const { return mDecoded; }
+
+private:
+    friend class QGraphicsMozViewPrivate;
+    void decode() const;
+    // Points the payload at the next message
+    void reset(const QChar* aData, int aLength, bool aBinary);
+    // Drops the borrowed data once delivery is over
+    void expire();
+
+    const QChar* mRaw;
+    int mLength;
+    bool mBinary;
+    bool mActive;
+    bool mExpired;
+    mutable bool mDecoded;
+    mutable bool mValid;
+    mutable QVariant mData;
+};
+
 class QGraphicsMozView : public QGraphicsWidget
 {
     Q_OBJECT
@@ -48,6 +121,18 @@ class QGraphicsMozView : public QGraphicsWidget
     Q_PROPERTY(QPointF scrollableOffset READ scrollableOffset)
     Q_PROPERTY(float resolution READ resolution)
     Q_PROPERTY(bool painted READ isPainted NOTIFY firstPaint FINAL)
+    Q_PROPERTY(bool threadedRendering READ threadedRendering WRITE setThreadedRendering)
+    Q_PROPERTY(int framesProduced READ framesProduced)
+    Q_PROPERTY(int framesPresented READ framesPresented)
+    Q_PROPERTY(int renderFormat READ renderFormat WRITE setRenderFormat)
+    Q_PROPERTY(bool sharedMemoryBuffer READ sharedMemoryBuffer WRITE setSharedMemoryBuffer)
+    Q_PROPERTY(int tileCacheSize READ tileCacheSize WRITE setTileCacheSize)
+    Q_PROPERTY(int tileCacheHits READ tileCacheHits)
+    Q_PROPERTY(int tileCacheMisses READ tileCacheMisses)
+    Q_PROPERTY(QVariantMap renderStatistics READ renderStatistics)
+    Q_PROPERTY(bool messageBatching READ messageBatching WRITE setMessageBatching)
+    Q_PROPERTY(QVariantMap syncMessageStatistics READ syncMessageStatistics)
+    Q_PROPERTY(QVariantMap messageLaneStatistics READ messageLaneStatistics)
 
 public:
     QGraphicsMozView(QGraphicsItem* parent = 0);
@@ -66,6 +151,30 @@ public:
     QPointF scrollableOffset() const;
     float resolution() const;
     bool isPainted() const;
+    bool threadedRendering() const;
+    void setThreadedRendering(bool aThreaded);
+    int framesProduced() const;
+    int framesPresented() const;
+    int renderFormat() const;
+    void setRenderFormat(int aFormat);
+    bool sharedMemoryBuffer() const;
+    void setSharedMemoryBuffer(bool aShared);
+    // Bytes of rendered tiles kept for software scrolling, 0 (the default)
+    // disables the cache. A scroll is composed from tiles only when the
+    // whole new viewport is cached, e.g. when scrolling back, newly exposed
+    // strips always need a full Gecko frame. Composed frames may show
+    // animated or fixed position content up to 150 ms out of date.
+    int tileCacheSize() const;
+    void setTileCacheSize(int aBytes);
+    int tileCacheHits() const;
+    int tileCacheMisses() const;
+    QVariantMap renderStatistics() const;
+    // Sends queued messages once per event loop pass in one envelope. Only
+    // names confirmed by MessageCodec.addBatchListener() in content qualify.
+    bool messageBatching() const;
+    void setMessageBatching(bool aBatching);
+    QVariantMap syncMessageStatistics() const;
+    QVariantMap messageLaneStatistics() const;
 
 public Q_SLOTS:
     void loadHtml(const QString& html, const QUrl& baseUrl = QUrl());
@@ -77,6 +186,23 @@ public Q_SLOTS:
     void sendAsyncMessage(const QString& name, const QVariant& variant);
     void addMessageListener(const QString& name);
     void loadFrameScript(const QString& name);
+    // "cbor" keeps binary data and integer types of a message name intact,
+    // it is slower than the default "json" on the content side
+    void setMessageEncoding(const QString& name, const QString& encoding);
+    QString messageEncoding(const QString& name) const;
+    // "low" queues a message name in both directions behind the default
+    // "high" lane, bulk traffic then can't delay input related messages.
+    // Moving a name back to "high" sends what is still queued for it first
+    void setMessagePriority(const QString& name, const QString& priority);
+    QString messagePriority(const QString& name) const;
+    // Returns the descriptor to put into a message payload, or an invalid
+    // variant if shared memory is not available. Freed once this side called
+    // releaseAttachment and content sent its release, each counted once
+    QVariant createAttachment(const QByteArray& data);
+    QVariant createImageAttachment(const QImage& image);
+    void releaseAttachment(const QVariant& descriptor);
+    bool registerMessageHandler(const QString& name, QObject* receiver, const QString& method);
+    void unregisterMessageHandler(const QString& name, QObject* receiver);
     void newWindow(const QString& url = "about:blank");
     quint32 uniqueID() const;
     void setParentID(unsigned aParentID);
@@ -84,6 +210,8 @@ public Q_SLOTS:
     void synthTouchMove(const QVariant& touches);
     void synthTouchEnd(const QVariant& touches);
     void scrollTo(const QPointF& position);
+    void dumpRenderStatistics();
+    void dumpSyncMessageStatistics();
 
 Q_SIGNALS:
     void viewInitialized();
@@ -94,6 +222,7 @@ Q_SIGNALS:
     void loadingChanged();
     void viewDestroyed();
     void recvAsyncMessage(const QString message, const QVariant data);
+    void recvAsyncMessagePayload(const QString message, QMozMessagePayload* payload);
     bool recvSyncMessage(const QString message, const QVariant data, QSyncMessageResponse* response);
     void loadRedirect();
     void securityChanged(QString status, uint state);
@@ -125,6 +254,13 @@ private Q_SLOTS:
     void onInitialized();
     void onDisplayEntered();
     void onDisplayExited();
+    void onFrameReady();
+    void onScrollSettled();
+    void flushMessageBatch();
+    void onMessageHandlerDestroyed(QObject* receiver);
+    void drainLowPriorityMessages();
+    void onSyncResponseCompleted();
+    void onSyncResponseTimeout();
 
 private:
     void forceActiveFocus();
@@ -10,16 +10,20 @@
 #include <QGLContext>
 #if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
 #include <QInputContext>
-#include <qjson/serializer.h>
-#include <qjson/parser.h>
-#else
-#include <QJsonDocument>
 #endif
 #include <QApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QPointer>
+#include <QMutexLocker>
 
 #include "qgraphicsmozview_p.h"
 #include "qgraphicsmozview.h"
 #include "qmozcontext.h"
+#include "renderworker.h"
+#include "shmbackbuffer.h"
+#include "messagecodec.h"
+#include "shmattachment.h"
 #include "InputData.h"
 #include "mozilla/embedlite/EmbedLog.h"
 #include "mozilla/embedlite/EmbedLiteApp.h"
@@ -27,6 +31,21 @@
 using namespace mozilla;
 using namespace mozilla::embedlite;
 
+// Envelope name for batched outgoing messages, split by messagecodec.js
+static const char kMessageBatchName[] = "embed:batch";
+// Sent by MessageCodec.addBatchListener() with the names it unpacks
+static const char kBatchReadyName[] = "embed:batch-ready";
+// Deferred sync message replies, {id, data}, and the ticket key content gets
+// instead of the value. MessageCodec.sendSyncMessage() pairs them up.
+static const char kSyncReplyName[] = "embed:sync-reply";
+static const char kSyncDeferredKey[] = "embed:deferred";
+// Sent by messagecodec.js when content is done with an attachment
+static const char kAttachmentReleaseName[] = "embed:attachment-release";
+// Low priority messages handled per direction and event loop pass, beyond
+// that only messages queued for longer than kLowPriorityMaxDelay ms go out
+static const int kLowPriorityBudget = 4;
+static const qint64 kLowPriorityMaxDelay = 100;
+
 QGraphicsMozViewPrivate::QGraphicsMozViewPrivate(QGraphicsMozView* view)
     : q(view)
     , mContext(NULL)
@@ -46,11 +65,45 @@ QGraphicsMozViewPrivate::QGraphicsMozViewPrivate(QGraphicsMozView* view)
     , mScrollableOffset(0,0)
     , mContentResolution(1.0)
     , mIsPainted(false)
-{
+    , mDisplayActive(true)
+    , mThreadedRendering(false)
+    , mRenderWorker(NULL)
+    , mRenderFormat(QImage::Format_Invalid)
+    , mShmBuffer(getenv("USE_SHM_BUFFER") ? new ShmBackBuffer() : NULL)
+    , mTileResolution(1.0)
+    , mScrollPending(false)
+    , mScrollOnlyFrame(false)
+    , mTilesStale(false)
+    , mTilesShown(false)
+    , mTilesBlocked(false)
+    , mScrollSettleTimer(NULL)
+    , mPayload(NULL)
+    , mMessageBatching(getenv("USE_MESSAGE_BATCHING") != 0)
+    , mBatchFlushPending(false)
+    , mNextSyncReplyId(0)
+    , mAttachmentListener(false)
+    , mLowDrainPending(false)
+    , mHighSent(0)
+    , mHighReceived(0)
+    , mLowSent(0)
+    , mLowReceived(0)
+    , mLowMaxDepth(0)
+    , mLowForcedByAge(0)
+{
+    mLaneClock.start();
+    mMessageBuffer.reserve(MessageCodec::kBufferReserve);
 }
 
 QGraphicsMozViewPrivate::~QGraphicsMozViewPrivate()
 {
+    if (mContext) {
+        mContext->GetFrameScheduler()->removeClient(this);
+    }
+    StopRenderWorker();
+    mTempBufferImage = QImage();
+    delete mShmBuffer;
+    qDeleteAll(mSyncMessageTime);
+    qDeleteAll(mAttachments);
 }
 
 QGraphicsView* QGraphicsMozViewPrivate::GetViewWidget()
@@ -69,6 +122,7 @@ void QGraphicsMozViewPrivate::UpdateViewSize()
         return;
     }
 
+    QMutexLocker lock(ViewMutex());
     if (mContext->GetApp()->IsAccelerated()) {
         const QGLContext* ctx = QGLContext::currentContext();
         if (ctx && ctx->device()) {
@@ -78,6 +132,58 @@ void QGraphicsMozViewPrivate::UpdateViewSize()
         }
     }
     mView->SetViewSize(mSize.width(), mSize.height());
+    if (mRenderWorker) {
+        mRenderWorker->setViewSize(mSize);
+        mRenderWorker->requestFrame();
+    }
+}
+
+void QGraphicsMozViewPrivate::StartRenderWorker()
+{
+    if (mRenderWorker || !mViewInitialized) {
+        return;
+    }
+    mRenderWorker = new RenderWorker(mView, &mRenderToImageTime);
+    mRenderWorker->setViewSize(mSize);
+    mRenderWorker->setBackgroundColor(mBgColor);
+    QObject::connect(mRenderWorker, SIGNAL(frameReady()), q, SLOT(onFrameReady()));
+    mRenderWorker->start();
+    mRenderWorker->requestFrame();
+}
+
+QMutex* QGraphicsMozViewPrivate::ViewMutex() const
+{
+    return mRenderWorker ? mRenderWorker->viewMutex() : NULL;
+}
+
+void QGraphicsMozViewPrivate::StopRenderWorker()
+{
+    if (!mRenderWorker) {
+        return;
+    }
+    mRenderWorker->stop();
+    delete mRenderWorker;
+    mRenderWorker = NULL;
+}
+
+QImage::Format QGraphicsMozViewPrivate::BackBufferFormat(QPaintDevice* aDevice) const
+{
+    if (mRenderFormat != QImage::Format_Invalid) {
+        return mRenderFormat;
+    }
+    // Rendering in the format of the target lets drawImage do a plain copy
+    if (aDevice && aDevice->devType() == QInternal::Image) {
+        QImage::Format format = static_cast<QImage*>(aDevice)->format();
+        if (format == QImage::Format_RGB16 ||
+            format == QImage::Format_RGB32 ||
+            format == QImage::Format_ARGB32_Premultiplied) {
+            return format;
+        }
+    }
+    if (aDevice && aDevice->depth() == 16) {
+        return QImage::Format_RGB16;
+    }
+    return mBgColor.alpha() < 255 ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
 }
 
 bool QGraphicsMozViewPrivate::RequestCurrentGLContext()
@@ -101,26 +207,90 @@ bool QGraphicsMozViewPrivate::RequestCurrentGLContext()
 void QGraphicsMozViewPrivate::ViewInitialized()
 {
     mViewInitialized = true;
+    mContext->markStartupPhase("first-view-initialized");
+    if (mThreadedRendering) {
+        StartRenderWorker();
+    }
     UpdateViewSize();
+    // Handlers registered before the view existed
+    Q_FOREACH(const QString& name, mMessageHandlers.keys()) {
+        mView->AddMessageListener(name.toUtf8().data());
+    }
+    // Frame scripts may confirm batching before the app enables it
+    mView->AddMessageListener(kBatchReadyName);
     // This is currently part of official API, so let's subscribe to these messages by default
     Q_EMIT q->viewInitialized();
     Q_EMIT q->navigationHistoryChanged();
 }
 
+void QGraphicsMozViewPrivate::AddDirtyRect(const QRect& aRect)
+{
+    QRect rect = aRect.intersected(QRect(QPoint(0, 0), mSize));
+    if (rect.isEmpty()) {
+        return;
+    }
+    mDirtyRegion += rect;
+    mContext->GetFrameScheduler()->scheduleFrame(this);
+}
+
 void QGraphicsMozViewPrivate::SetBackgroundColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
-    mBgColor = QColor(r, g, b, a);
+    if (mBgColor != QColor(r, g, b, a)) {
+        mBgColor = QColor(r, g, b, a);
+        if (mRenderWorker) {
+            mRenderWorker->setBackgroundColor(mBgColor);
+        }
+        AddDirtyRect(QRect(QPoint(0, 0), mSize));
+    }
 }
 
 bool QGraphicsMozViewPrivate::Invalidate()
 {
-    q->update();
+    if (!mRenderWorker || mContext->GetApp()->IsAccelerated()) {
+        if (mScrollPending && !mTilesBlocked && !mContext->GetApp()->IsAccelerated() &&
+            mTiles.covers(QRect(mTileOffset, mSize))) {
+            // Content only moved and the cache has all of it, compose the
+            // frame from tiles instead of asking Gecko for it
+            mScrollOnlyFrame = true;
+        } else {
+            // Without a scroll content itself changed, cached tiles outside
+            // of the new frame cannot be trusted anymore
+            mTilesStale = mTilesStale || !mScrollPending;
+            // Gecko does not tell us which area changed, so the whole view
+            // has to be rendered again on next paint
+            mDirtyRegion += QRect(QPoint(0, 0), mSize);
+        }
+        mScrollPending = false;
+    }
+    mContext->GetFrameScheduler()->scheduleFrame(this);
     return true;
 }
 
+void QGraphicsMozViewPrivate::ScheduledFrame()
+{
+    if (mRenderWorker && !mContext->GetApp()->IsAccelerated()) {
+        // Render thread notifies us with frameReady once the frame is done
+        mRenderWorker->requestFrame();
+        return;
+    }
+    if (mDirtyRegion.isEmpty()) {
+        q->update();
+    } else {
+        q->update(mDirtyRegion.boundingRect());
+    }
+}
+
+bool QGraphicsMozViewPrivate::IsFrameActive() const
+{
+    return mDisplayActive;
+}
+
 void QGraphicsMozViewPrivate::OnLocationChanged(const char* aLocation, bool aCanGoBack, bool aCanGoForward)
 {
     mLocation = QString(aLocation);
+    // New document, give the tile cache another chance
+    mTilesBlocked = false;
+    mTilesStale = true;
     if (mCanGoBack != aCanGoBack || mCanGoForward != aCanGoForward) {
         mCanGoBack = aCanGoBack;
         mCanGoForward = aCanGoForward;
@@ -161,68 +331,387 @@ void QGraphicsMozViewPrivate::OnLoadFinished(void)
 void QGraphicsMozViewPrivate::ViewDestroyed()
 {
     LOGT();
+    StopRenderWorker();
     mView = NULL;
     mViewInitialized = false;
+    mAttachmentListener = false;
+    mBatchedMessages.clear();
+    mOutgoingBatch.clear();
+    // Nobody is left to reply to
+    Q_FOREACH(QSyncMessageResponse* response, mPendingSyncReplies.keys()) {
+        response->deleteLater();
+    }
+    mPendingSyncReplies.clear();
+    // Content is gone, nobody will release these anymore
+    qDeleteAll(mAttachments);
+    mAttachments.clear();
+    mLowOutgoing.clear();
+    mLowIncoming.clear();
     Q_EMIT q->viewDestroyed();
 }
 
+void QGraphicsMozViewPrivate::SendAsyncMessage(const QString& aName, const QVariant& aData)
+{
+    if (mBinaryMessages.contains(aName)) {
+        QString payload = MessageCodec::EncodeBinaryPayload(aData);
+        mView->SendAsyncMessage((const PRUnichar*)aName.constData(), (const PRUnichar*)payload.constData());
+        return;
+    }
+
+    mMessageBuffer.truncate(0);
+    MessageCodec::WriteJson(aData, mMessageBuffer);
+    mView->SendAsyncMessage((const PRUnichar*)aName.constData(), (const PRUnichar*)mMessageBuffer.constData());
+}
+
+void QGraphicsMozViewPrivate::PostAsyncMessage(const QString& aName, const QVariant& aData)
+{
+    if (mMessageBatching && mBatchedMessages.contains(aName)) {
+        QVariantMap entry;
+        entry.insert("name", aName);
+        if (mBinaryMessages.contains(aName)) {
+            // Content side decodes the entry data just like an unbatched message
+            entry.insert("data", QString::fromLatin1(MessageCodec::EncodeCbor(aData).toBase64()));
+        } else {
+            entry.insert("data", aData);
+        }
+        mOutgoingBatch.append(entry);
+        if (!mBatchFlushPending) {
+            mBatchFlushPending = true;
+            QTimer::singleShot(0, q, SLOT(flushMessageBatch()));
+        }
+        return;
+    }
+
+    // Keep the order with batched messages still waiting for the flush
+    if (!mOutgoingBatch.isEmpty()) {
+        FlushMessageBatch();
+    }
+    SendAsyncMessage(aName, aData);
+}
+
+void QGraphicsMozViewPrivate::ScheduleLowPriorityDrain()
+{
+    if (!mLowDrainPending) {
+        mLowDrainPending = true;
+        QTimer::singleShot(0, q, SLOT(drainLowPriorityMessages()));
+    }
+}
+
+void QGraphicsMozViewPrivate::DrainLowPriorityMessages()
+{
+    mLowDrainPending = false;
+    qint64 now = mLaneClock.elapsed();
+
+    // High priority messages never wait here, and get in between passes
+    int budget = kLowPriorityBudget;
+    while (!mLowOutgoing.isEmpty() && mView) {
+        if (budget-- <= 0) {
+            if (now - mLowOutgoing.head().mQueuedAt < kLowPriorityMaxDelay) {
+                break;
+            }
+            mLowForcedByAge++;
+        }
+        LowPriorityMessage message = mLowOutgoing.dequeue();
+        mLowSent++;
+        PostAsyncMessage(message.mName, message.mData);
+    }
+
+    QPointer<QGraphicsMozView> alive(q);
+    budget = kLowPriorityBudget;
+    while (!mLowIncoming.isEmpty()) {
+        if (budget-- <= 0) {
+            if (now - mLowIncoming.head().mQueuedAt < kLowPriorityMaxDelay) {
+                break;
+            }
+            mLowForcedByAge++;
+        }
+        LowPriorityMessage message = mLowIncoming.dequeue();
+        mLowReceived++;
+        DispatchAsyncMessage(message.mName, message.mRaw.constData(), message.mRaw.size());
+        if (!alive) {
+            // A handler deleted the view
+            return;
+        }
+    }
+
+    if (!mLowIncoming.isEmpty() || (!mLowOutgoing.isEmpty() && mView)) {
+        ScheduleLowPriorityDrain();
+    }
+}
+
+void QGraphicsMozViewPrivate::FlushLowPriorityMessages(const QString& aName)
+{
+    if (mView) {
+        QQueue<LowPriorityMessage> kept;
+        while (!mLowOutgoing.isEmpty()) {
+            LowPriorityMessage message = mLowOutgoing.dequeue();
+            if (message.mName != aName) {
+                kept.enqueue(message);
+                continue;
+            }
+            mLowSent++;
+            PostAsyncMessage(message.mName, message.mData);
+        }
+        mLowOutgoing = kept;
+    }
+
+    // Take them out first, handlers may queue more or delete the view
+    QQueue<LowPriorityMessage> flushed;
+    QQueue<LowPriorityMessage> kept;
+    while (!mLowIncoming.isEmpty()) {
+        LowPriorityMessage message = mLowIncoming.dequeue();
+        (message.mName == aName ? flushed : kept).enqueue(message);
+    }
+    mLowIncoming = kept;
+
+    QPointer<QGraphicsMozView> alive(q);
+    while (!flushed.isEmpty() && alive) {
+        LowPriorityMessage message = flushed.dequeue();
+        mLowReceived++;
+        DispatchAsyncMessage(message.mName, message.mRaw.constData(), message.mRaw.size());
+    }
+}
+
+void QGraphicsMozViewPrivate::FlushMessageBatch()
+{
+    mBatchFlushPending = false;
+    if (mOutgoingBatch.isEmpty()) {
+        return;
+    }
+
+    QVariantList batch;
+    batch.swap(mOutgoingBatch);
+    if (!mView) {
+        return;
+    }
+
+    if (batch.size() == 1) {
+        // Not worth an envelope
+        QVariantMap entry = batch.first().toMap();
+        SendAsyncMessage(entry.value("name").toString(), entry.value("data"));
+        return;
+    }
+
+    LOGT("messages:%i", batch.size());
+    SendAsyncMessage(QLatin1String(kMessageBatchName), batch);
+}
+
+QVariant QGraphicsMozViewPrivate::AddAttachment(ShmAttachment* aAttachment)
+{
+    if (!aAttachment) {
+        return QVariant();
+    }
+    if (!mAttachmentListener && mView) {
+        mView->AddMessageListener(kAttachmentReleaseName);
+        mAttachmentListener = true;
+    }
+    mAttachments.insert(aAttachment->id(), aAttachment);
+    LOGT("attachment:%u, size:%i", aAttachment->id(), aAttachment->size());
+    return aAttachment->descriptor();
+}
+
+void QGraphicsMozViewPrivate::ReleaseAttachment(quint32 aId, ShmAttachment::Side aSide)
+{
+    QHash<quint32, ShmAttachment*>::iterator it = mAttachments.find(aId);
+    if (it == mAttachments.end()) {
+        LOGT("unknown attachment:%u", aId);
+        return;
+    }
+    if (it.value()->release(aSide)) {
+        LOGT("attachment:%u freed", aId);
+        delete it.value();
+        mAttachments.erase(it);
+    }
+}
+
 void QGraphicsMozViewPrivate::RecvAsyncMessage(const PRUnichar* aMessage, const PRUnichar* aData)
 {
-    NS_ConvertUTF16toUTF8 message(aMessage);
-    NS_ConvertUTF16toUTF8 data(aData);
+    QString message = QString::fromUtf16((const ushort*)aMessage);
+    if (message == QLatin1String(kAttachmentReleaseName)) {
+        nsDependentString data(aData);
+        QVariant vdata = MessageCodec::DecodeJson((const QChar*)data.get(), data.Length());
+        ReleaseAttachment(vdata.toMap().value("attachment").toUInt(), ShmAttachment::Content);
+        return;
+    }
+    if (message == QLatin1String(kBatchReadyName)) {
+        nsDependentString data(aData);
+        QVariant vdata = MessageCodec::DecodeJson((const QChar*)data.get(), data.Length());
+        Q_FOREACH(const QVariant& name, vdata.toMap().value("names").toList()) {
+            mBatchedMessages.insert(name.toString());
+        }
+        LOGT("batched names:%i", mBatchedMessages.size());
+        return;
+    }
 
-    bool ok = false;
-#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
-    QJson::Parser parser;
-    QVariant vdata = parser.parse(QByteArray(data.get()), &ok);
-#else
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(QByteArray(data.get()), &error);
-    ok = error.error == QJsonParseError::NoError;
-    QVariant vdata = doc.toVariant();
-#endif
+    nsDependentString data(aData);
+    if (mLowPriorityMessages.contains(message)) {
+        LowPriorityMessage queued;
+        queued.mName = message;
+        queued.mRaw = QString((const QChar*)data.get(), data.Length());
+        queued.mQueuedAt = mLaneClock.elapsed();
+        mLowIncoming.enqueue(queued);
+        mLowMaxDepth = qMax(mLowMaxDepth, mLowIncoming.size());
+        ScheduleLowPriorityDrain();
+        return;
+    }
 
-    if (ok) {
-        LOGT("mesg:%s, data:%s", message.get(), data.get());
-        Q_EMIT q->recvAsyncMessage(message.get(), vdata);
-    } else {
-#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
-        LOGT("parse: err:%s, errLine:%i", parser.errorString().toUtf8().data(), parser.errorLine());
-#else
-        LOGT("parse: err:%s, errLine:%i", error.errorString().toUtf8().data(), error.offset);
-#endif
+    mHighReceived++;
+    DispatchAsyncMessage(message, (const QChar*)data.get(), data.Length());
+}
+
+void QGraphicsMozViewPrivate::DispatchAsyncMessage(const QString& message, const QChar* aData, int aLength)
+{
+    // Copy, handlers may (un)register while being called
+    QList<MessageHandler> handlers = mMessageHandlers.value(message);
+    bool wantsVariant = q->receivers(SIGNAL(recvAsyncMessage(QString,QVariant))) > 0;
+    bool wantsPayload = q->receivers(SIGNAL(recvAsyncMessagePayload(QString,QMozMessagePayload*))) > 0;
+    if (!wantsVariant && !wantsPayload && handlers.isEmpty()) {
+        // Nobody would look at the data, don't spend time decoding it
+        return;
+    }
+
+    // aData is freed once we return. The payload outlives the call, so a
+    // queued recvAsyncMessagePayload receiver finds it expired instead of
+    // reading freed memory. A nested delivery gets a payload of its own
+    QMozMessagePayload* payload = mPayload;
+    if (!payload || payload->mActive) {
+        payload = new QMozMessagePayload(NULL, 0, false, q);
+        if (!mPayload) {
+            mPayload = payload;
+        }
+    }
+    payload->reset(aData, aLength, mBinaryMessages.contains(message));
+
+    if (!handlers.isEmpty()) {
+        if (payload->isValid()) {
+            QVariant vdata = payload->data();
+            QVariant vmessage(message);
+            Q_FOREACH(const MessageHandler& handler, handlers) {
+                if (!handler.mReceiver) {
+                    // Destroyed by an earlier handler of this message
+                    continue;
+                }
+                if (handler.mVariantName) {
+                    handler.mMethod.invoke(handler.mReceiver, Qt::DirectConnection,
+                                           Q_ARG(QVariant, vmessage), Q_ARG(QVariant, vdata));
+                } else {
+                    handler.mMethod.invoke(handler.mReceiver, Qt::DirectConnection,
+                                           Q_ARG(QString, message), Q_ARG(QVariant, vdata));
+                }
+            }
+        } else {
+            LOGT("mesg:%s, undecodable payload not passed to handlers", message.toUtf8().data());
+        }
+    }
+
+    if (wantsPayload) {
+        LOGT("mesg:%s, lazy payload:%i", message.toUtf8().data(), aLength);
+        Q_EMIT q->recvAsyncMessagePayload(message, payload);
+    }
+
+    if (wantsVariant) {
+        if (payload->isValid()) {
+            LOGT("mesg:%s, data:%s", message.toUtf8().data(), QString(aData, aLength).toUtf8().data());
+            Q_EMIT q->recvAsyncMessage(message, payload->data());
+        } else {
+            LOGT("mesg:%s, undecodable payload dropped", message.toUtf8().data());
+        }
+    }
+
+    payload->expire();
+    if (payload != mPayload) {
+        payload->deleteLater();
     }
 }
 
 char* QGraphicsMozViewPrivate::RecvSyncMessage(const PRUnichar* aMessage, const PRUnichar*  aData)
 {
-    QSyncMessageResponse response;
-    NS_ConvertUTF16toUTF8 message(aMessage);
-    NS_ConvertUTF16toUTF8 data(aData);
+    QElapsedTimer blocked;
+    blocked.start();
+
+    QSyncMessageResponse* response = new QSyncMessageResponse();
+    QString message = QString::fromUtf16((const ushort*)aMessage);
+    nsDependentString data(aData);
 
     bool ok = false;
-#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
-    QJson::Parser parser;
-    QVariant vdata = parser.parse(QByteArray(data.get()), &ok);
-#else
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(QByteArray(data.get()), &error);
-    ok = error.error == QJsonParseError::NoError;
-    QVariant vdata = doc.toVariant();
-#endif
-    Q_EMIT q->recvSyncMessage(message.get(), vdata, &response);
+    QString error;
+    QVariant vdata = MessageCodec::DecodeJson((const QChar*)data.get(), data.Length(), &ok, &error);
+    if (!ok) {
+        LOGT("parse: err:%s", error.toUtf8().data());
+    }
+    QPointer<QGraphicsMozView> alive(q);
+    Q_EMIT q->recvSyncMessage(message, vdata, response);
+
+    QString json;
+    if (alive && response->isDeferred() && !response->isCompleted()) {
+        // No nested event loop here: content gets a ticket now and the value
+        // as an async message later, so nothing is re-entered while it waits
+        PendingSyncReply pending;
+        pending.mId = ++mNextSyncReplyId;
+        pending.mName = message;
+        pending.mAge = blocked;
+        mPendingSyncReplies.insert(response, pending);
+        response->setParent(q);
+        QObject::connect(response, SIGNAL(completedChanged()), q, SLOT(onSyncResponseCompleted()));
+        QTimer* timer = new QTimer(response);
+        timer->setSingleShot(true);
+        QObject::connect(timer, SIGNAL(timeout()), q, SLOT(onSyncResponseTimeout()));
+        timer->start(response->timeout());
+
+        QVariantMap ticket;
+        ticket.insert(QLatin1String(kSyncDeferredKey), pending.mId);
+        MessageCodec::WriteJson(ticket, json);
+        LOGT("msg:%s, deferred as:%u", message.toUtf8().data(), pending.mId);
+        return strdup(json.toUtf8().constData());
+    }
 
-#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
-    QJson::Serializer serializer;
-    QByteArray array = serializer.serialize(response.getMessage());
-#else
-    QJsonDocument respdoc = QJsonDocument::fromVariant(response.getMessage());
-    QByteArray array = respdoc.toJson();
-#endif
-    LOGT("msg:%s, response:%s", message.get(), array.constData());
+    // Handlers may still hold the pointer until control returns to them
+    response->deleteLater();
+    MessageCodec::WriteJson(response->getMessage(), json);
+    QByteArray array = json.toUtf8();
+    if (!alive) {
+        // View went away in the handler
+        return strdup(array.constData());
+    }
+
+    RecordSyncReply(message, blocked.nsecsElapsed() / 1000, false);
+    LOGT("msg:%s, response:%s", message.toUtf8().data(), array.constData());
     return strdup(array.constData());
 }
 
+void QGraphicsMozViewPrivate::SendSyncReply(QSyncMessageResponse* aResponse, bool aTimedOut)
+{
+    QHash<QSyncMessageResponse*, PendingSyncReply>::iterator it = mPendingSyncReplies.find(aResponse);
+    if (it == mPendingSyncReplies.end()) {
+        // Already answered, e.g. complete() after the timeout
+        return;
+    }
+    PendingSyncReply pending = it.value();
+    mPendingSyncReplies.erase(it);
+    RecordSyncReply(pending.mName, pending.mAge.nsecsElapsed() / 1000, aTimedOut);
+
+    if (mView) {
+        QVariantMap reply;
+        reply.insert("id", pending.mId);
+        reply.insert("data", aResponse->getMessage());
+        PostAsyncMessage(QLatin1String(kSyncReplyName), reply);
+    }
+    LOGT("msg:%s, id:%u, timedOut:%i", pending.mName.toUtf8().data(), pending.mId, aTimedOut);
+    aResponse->deleteLater();
+}
+
+void QGraphicsMozViewPrivate::RecordSyncReply(const QString& aName, qint64 aMicroseconds, bool aTimedOut)
+{
+    LatencyHistogram*& histogram = mSyncMessageTime[aName];
+    if (!histogram) {
+        histogram = new LatencyHistogram();
+    }
+    histogram->record(aMicroseconds);
+    if (aTimedOut) {
+        mSyncMessageTimeouts[aName]++;
+    }
+}
+
 void QGraphicsMozViewPrivate::OnLoadRedirect(void)
 {
     LOGT();
@@ -238,6 +727,7 @@ void QGraphicsMozViewPrivate::OnFirstPaint(int32_t aX, int32_t aY)
 {
     LOGT();
     mIsPainted = true;
+    mContext->markStartupPhase("first-paint");
     Q_EMIT q->firstPaint(aX, aY);
 }
 
@@ -324,7 +814,13 @@ void QGraphicsMozViewPrivate::SetPageRect(const gfxRect& aCssPageRect)
 bool QGraphicsMozViewPrivate::SendAsyncScrollDOMEvent(const gfxRect& aContentRect, const gfxSize& aScrollableSize)
 {
     mContentRect = QRect(aContentRect.x, aContentRect.y, aContentRect.width, aContentRect.height);
-    mScrollableSize = QSize(aScrollableSize.width, aScrollableSize.height);
+    QSize scrollableSize(aScrollableSize.width, aScrollableSize.height);
+    if (scrollableSize != mScrollableSize) {
+        // Layout changed, not just the scroll offset
+        mTilesStale = true;
+        mScrollPending = false;
+    }
+    mScrollableSize = scrollableSize;
     Q_EMIT q->viewAreaChanged();
     return false;
 }
@@ -333,6 +829,16 @@ bool QGraphicsMozViewPrivate::ScrollUpdate(const gfxPoint& aPosition, const floa
 {
     mScrollableOffset = QPointF(aPosition.x, aPosition.y);
     mContentResolution = aResolution;
+    if (mTiles.isEnabled()) {
+        QPoint offset(qRound(aPosition.x * aResolution), qRound(aPosition.y * aResolution));
+        if (aResolution != mTileResolution) {
+            mTiles.clear();
+            mTileResolution = aResolution;
+        } else if (offset != mTileOffset) {
+            mScrollPending = true;
+        }
+        mTileOffset = offset;
+    }
     Q_EMIT q->viewAreaChanged();
     return false;
 }
@@ -13,14 +13,60 @@
 #include <QTime>
 #include <QString>
 #include <QPointF>
+#include <QRegion>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QMetaMethod>
+#include <QHash>
+#include <QSet>
+#include <QPointer>
 #include "mozilla/embedlite/EmbedLiteView.h"
+#include "framescheduler.h"
+#include "tiledbackingstore.h"
+#include "latencyhistogram.h"
+#include "shmattachment.h"
 
 class QGraphicsView;
+class QPaintDevice;
 class QTouchEvent;
+class QMutex;
+class QTimer;
 class QGraphicsMozView;
+class QMozMessagePayload;
+class QSyncMessageResponse;
 class QMozContext;
+class RenderWorker;
+class ShmBackBuffer;
+
+struct MessageHandler
+{
+    // Cleared when the receiver is destroyed, even mid dispatch
+    QPointer<QObject> mReceiver;
+    QMetaMethod mMethod;
+    // Method takes (QVariant, QVariant) as QML functions do, else (QString, QVariant)
+    bool mVariantName;
+};
+
+// Deferred sync message response waiting for complete() or its timeout
+struct PendingSyncReply
+{
+    quint32 mId;
+    QString mName;
+    QElapsedTimer mAge;
+};
+
+struct LowPriorityMessage
+{
+    QString mName;
+    // Outgoing data
+    QVariant mData;
+    // Incoming data as received, decoded on dispatch
+    QString mRaw;
+    qint64 mQueuedAt;
+};
 
 class QGraphicsMozViewPrivate : public mozilla::embedlite::EmbedLiteViewListener
+                              , public FrameSchedulerClient
 {
 public:
     QGraphicsMozViewPrivate(QGraphicsMozView* view);
@@ -30,6 +76,25 @@ public:
     void ReceiveInputEvent(const mozilla::InputData& event);
     void touchEvent(QTouchEvent* event);
     void UpdateViewSize();
+    void AddDirtyRect(const QRect& aRect);
+    void StartRenderWorker();
+    void StopRenderWorker();
+    // Lock around GUI thread calls on mView that change what RenderToImage
+    // reads, see RenderWorker::viewMutex(). NULL without a worker
+    QMutex* ViewMutex() const;
+    QImage::Format BackBufferFormat(QPaintDevice* aDevice) const;
+    void SendAsyncMessage(const QString& aName, const QVariant& aData);
+    void PostAsyncMessage(const QString& aName, const QVariant& aData);
+    void DispatchAsyncMessage(const QString& aMessage, const QChar* aData, int aLength);
+    void ScheduleLowPriorityDrain();
+    void DrainLowPriorityMessages();
+    // Sends and dispatches everything queued for aName, in order
+    void FlushLowPriorityMessages(const QString& aName);
+    void FlushMessageBatch();
+    void SendSyncReply(QSyncMessageResponse* aResponse, bool aTimedOut);
+    void RecordSyncReply(const QString& aName, qint64 aMicroseconds, bool aTimedOut);
+    QVariant AddAttachment(ShmAttachment* aAttachment);
+    void ReleaseAttachment(quint32 aId, ShmAttachment::Side aSide);
     virtual bool RequestCurrentGLContext();
     virtual void ViewInitialized();
     virtual void SetBackgroundColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
@@ -63,12 +128,16 @@ public:
     virtual bool HandleSingleTap(const nsIntPoint& aPoint);
     virtual bool HandleDoubleTap(const nsIntPoint& aPoint);
 
+    virtual void ScheduledFrame();
+    virtual bool IsFrameActive() const;
+
     QGraphicsMozView* q;
     QMozContext* mContext;
     mozilla::embedlite::EmbedLiteView* mView;
     bool mViewInitialized;
     QColor mBgColor;
     QImage mTempBufferImage;
+    QRegion mDirtyRegion;
     QSize mSize;
     QTime mTouchTime;
     bool mPendingTouchEvent;
@@ -87,6 +156,63 @@ public:
     QPointF mScrollableOffset;
     float mContentResolution;
     bool mIsPainted;
+    bool mDisplayActive;
+    bool mThreadedRendering;
+    RenderWorker* mRenderWorker;
+    // Format_Invalid means it is picked to match the paint device
+    QImage::Format mRenderFormat;
+    // Set when the back buffer lives in shared memory
+    ShmBackBuffer* mShmBuffer;
+    // Software content cache reused while scrolling
+    TiledBackingStore mTiles;
+    // Content offset of the next frame in device pixels
+    QPoint mTileOffset;
+    float mTileResolution;
+    bool mScrollPending;
+    bool mScrollOnlyFrame;
+    bool mTilesStale;
+    // Set once a frame was composed from tiles, the next rendered frame
+    // verifies them
+    bool mTilesShown;
+    // Page has content that does not scroll with the offset
+    bool mTilesBlocked;
+    // Takes a real frame once scroll updates stop coming
+    QTimer* mScrollSettleTimer;
+    LatencyHistogram mRenderGLTime;
+    LatencyHistogram mRenderToImageTime;
+    // Message names exchanged as CBOR instead of JSON text
+    QSet<QString> mBinaryMessages;
+    // Shared by all receivers of a message, reused between messages
+    QMozMessagePayload* mPayload;
+    bool mMessageBatching;
+    // Names a frame script confirmed to unpack from batch envelopes, only
+    // these are batched
+    QSet<QString> mBatchedMessages;
+    bool mBatchFlushPending;
+    // Queued {name, data} entries, sent as one envelope per event loop pass
+    QVariantList mOutgoingBatch;
+    // Serialization buffer reused by SendAsyncMessage
+    QString mMessageBuffer;
+    // Time until content got the reply, per message name
+    QHash<QString, LatencyHistogram*> mSyncMessageTime;
+    QHash<QString, int> mSyncMessageTimeouts;
+    quint32 mNextSyncReplyId;
+    QHash<QSyncMessageResponse*, PendingSyncReply> mPendingSyncReplies;
+    QHash<QString, QList<MessageHandler> > mMessageHandlers;
+    QHash<quint32, ShmAttachment*> mAttachments;
+    bool mAttachmentListener;
+    // Message names in the low priority lane
+    QSet<QString> mLowPriorityMessages;
+    QQueue<LowPriorityMessage> mLowOutgoing;
+    QQueue<LowPriorityMessage> mLowIncoming;
+    bool mLowDrainPending;
+    QElapsedTimer mLaneClock;
+    int mHighSent;
+    int mHighReceived;
+    int mLowSent;
+    int mLowReceived;
+    int mLowMaxDepth;
+    int mLowForcedByAge;
 };
 
 #endif /* qgraphicsmozview_p_h */
@@ -11,8 +11,11 @@
 #include <QApplication>
 #include <QVariant>
 #include <QThread>
+#include <QHash>
+#include <QSet>
+#include <QFile>
+#include <QElapsedTimer>
 #if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
-#include <qjson/serializer.h>
 #include <qjson/parser.h>
 #else
 #include <QJsonDocument>
@@ -21,6 +24,11 @@
 
 #include "qmozcontext.h"
 #include "geckoworker.h"
+#include "geckothreadpolicy.h"
+#include "framescheduler.h"
+#include "viewpool.h"
+#include "prefsfile.h"
+#include "messagecodec.h"
 
 #include "nsDebug.h"
 #include "mozilla/embedlite/EmbedLiteApp.h"
@@ -31,6 +39,35 @@ using namespace mozilla::embedlite;
 
 static QMozContext* protectSingleton = nullptr;
 
+// Loads libxul and creates EmbedLiteApp off the GUI thread, see preload()
+class BootstrapThread : public QThread
+{
+public:
+    BootstrapThread() : mApp(NULL) {}
+
+    virtual void run() {
+        QElapsedTimer timer;
+        timer.start();
+        LoadEmbedLite();
+        mApp = XRE_GetEmbedLite();
+        LOGT("Bootstrap took %lli ms", timer.elapsed());
+    }
+
+    EmbedLiteApp* mApp;
+};
+
+static BootstrapThread* sBootstrap = nullptr;
+
+// Keyed by the UTF-8 topic Gecko hands to OnObserve
+struct ObserverTopic
+{
+    ObserverTopic() : mRefs(0), mRegistered(false) {}
+    // Converted once, emitted with every notification
+    QString mName;
+    int mRefs;
+    bool mRegistered;
+};
+
 class QMozContextPrivate : public EmbedLiteAppListener {
 public:
     QMozContextPrivate(QMozContext* qq)
@@ -39,7 +76,13 @@ public:
     , mInitialized(false)
     , mThread(new QThread())
     , mEmbedStarted(false)
+    , mFrameScheduler(new FrameScheduler())
+    , mViewPool(new ViewPool())
+    , mSkippedPrefs(0)
     {
+        mStartupClock.start();
+        mThreadPolicy.loadFromEnvironment();
+        mObserveBuffer.reserve(MessageCodec::kBufferReserve);
     }
 
     virtual ~QMozContextPrivate() {
@@ -49,18 +92,21 @@ public:
             mThread->wait();
         }
         delete mThread;
+        delete mFrameScheduler;
+        delete mViewPool;
     }
 
     virtual bool ExecuteChildThread() {
         if (!getenv("GECKO_THREAD")) {
             LOGT("Execute in child Native thread: %p", mThread);
-            GeckoWorker *worker = new GeckoWorker(mApp);
+            GeckoWorker *worker = new GeckoWorker(mApp, &mThreadPolicy);
 
             QObject::connect(mThread, SIGNAL(started()), worker, SLOT(doWork()));
             QObject::connect(mThread, SIGNAL(finished()), worker, SLOT(quit()));
             worker->moveToThread(mThread);
 
-            mThread->start(QThread::LowPriority);
+            mThread->start(mThreadPolicy.priority());
+            MarkStartupPhase("gecko-thread-started");
             return true;
         }
         return false;
@@ -77,6 +123,7 @@ public:
     }
     // App Initialized and ready to API call
     virtual void Initialized() {
+        MarkStartupPhase("initialized");
         mInitialized = true;
 #ifdef GL_PROVIDER_EGL
         if (mApp->GetRenderType() == EmbedLiteApp::RENDER_AUTO) {
@@ -84,14 +131,26 @@ public:
         }
 #endif
         setDefaultPrefs();
+        // Prefs set before initialization override the defaults
+        QVariantMap::const_iterator pref = mPendingPrefs.constBegin();
+        for (; pref != mPendingPrefs.constEnd(); ++pref) {
+            ApplyPref(pref.key(), pref.value());
+        }
+        LOGT("Applied %i queued prefs", mPendingPrefs.size());
+        mPendingPrefs.clear();
+        MarkStartupPhase("default-prefs");
         mApp->LoadGlobalStyleSheet("chrome://global/content/embedScrollStyles.css", true);
+        MarkStartupPhase("global-stylesheet");
         Q_EMIT q->onInitialized();
-        QListIterator<QString> i(mObserversList);
-        while (i.hasNext()) {
-            const QString& str = i.next();
-            mApp->AddObserver(str.toUtf8().data());
+        // Views created on onInitialized go first, the pool fills up later
+        mViewPool->start(mApp);
+        QHash<QByteArray, ObserverTopic>::iterator it = mObservers.begin();
+        for (; it != mObservers.end(); ++it) {
+            if (it->mRefs > 0 && !it->mRegistered) {
+                mApp->AddObserver(it.key().constData());
+                it->mRegistered = true;
+            }
         }
-        mObserversList.clear();
     }
     // App Destroyed, and ready to delete and program exit
     virtual void Destroyed() {
@@ -99,10 +158,27 @@ public:
     }
     virtual void OnObserve(const char* aTopic, const PRUnichar* aData) {
         // LOGT("aTopic: %s, data: %s", aTopic, NS_ConvertUTF16toUTF8(aData).get());
+        if (q->receivers(SIGNAL(recvObserve(QString,QVariant))) == 0) {
+            return;
+        }
+        // Wraps aTopic without copying it
+        QHash<QByteArray, ObserverTopic>::const_iterator topic =
+            mObservers.constFind(QByteArray::fromRawData(aTopic, qstrlen(aTopic)));
+        QString name;
+        if (topic != mObservers.constEnd()) {
+            if (topic->mRefs == 0) {
+                // Unsubscribed with removeObserver meanwhile
+                return;
+            }
+            name = topic->mName;
+        } else {
+            // Registered directly with GetApp()->AddObserver()
+            name = QString::fromUtf8(aTopic);
+        }
         QString data((QChar*)aData);
         if (!data.startsWith('{') && !data.startsWith('[') && !data.startsWith('"')) {
             QVariant vdata = QVariant::fromValue(data);
-            Q_EMIT q->recvObserve(aTopic, vdata);
+            Q_EMIT q->recvObserve(name, vdata);
             return;
         }
         bool ok = true;
@@ -117,7 +193,7 @@ public:
 #endif
         if (ok) {
             // LOGT("mesg:%s, data:%s", aTopic, data.toUtf8().data());
-            Q_EMIT q->recvObserve(aTopic, vdata);
+            Q_EMIT q->recvObserve(name, vdata);
         } else {
 #if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
             LOGT("parse: s:'%s', err:%s, errLine:%i", data.toUtf8().data(), parser.errorString().toUtf8().data(), parser.errorLine());
@@ -148,6 +224,97 @@ public:
     }
     bool IsInitialized() { return mApp && mInitialized; }
 
+    void ApplyPref(const QString& aName, const QVariant& aPref)
+    {
+        // Only tracks values set from here, changes made inside Gecko are not seen
+        QHash<QString, QVariant>::const_iterator last = mAppliedPrefs.constFind(aName);
+        if (last != mAppliedPrefs.constEnd() && last->type() == aPref.type() && *last == aPref) {
+            mSkippedPrefs++;
+            return;
+        }
+        QByteArray name = aName.toUtf8();
+        switch (aPref.type()) {
+        case QVariant::String:
+            mApp->SetCharPref(name.constData(), aPref.toString().toUtf8().constData());
+            break;
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+            mApp->SetIntPref(name.constData(), aPref.toInt());
+            break;
+        case QVariant::Bool:
+            mApp->SetBoolPref(name.constData(), aPref.toBool());
+            break;
+        case QMetaType::Float:
+        case QMetaType::Double:
+            if (aPref.canConvert<int>()) {
+                mApp->SetIntPref(name.constData(), aPref.toInt());
+            } else {
+                mApp->SetCharPref(name.constData(), aPref.toString().toUtf8().constData());
+            }
+            break;
+        default:
+            LOGT("Unknown pref type: %i", aPref.type());
+            return;
+        }
+        mAppliedPrefs.insert(aName, aPref);
+    }
+
+    // Each phase is recorded once, the first time it is reached
+    void MarkStartupPhase(const QString& aPhase)
+    {
+        if (mStartupPhases.contains(aPhase)) {
+            return;
+        }
+        qreal time = mStartupClock.nsecsElapsed() / 1000000.0;
+        qreal previous = mStartupTimeline.isEmpty() ? 0 : mStartupTimeline.last().toMap().value("time").toReal();
+        QVariantMap mark;
+        mark.insert("phase", aPhase);
+        mark.insert("time", time);
+        mark.insert("delta", time - previous);
+        mStartupTimeline.append(mark);
+        mStartupPhases.insert(aPhase);
+        LOGT("phase:%s, time:%.3fms", aPhase.toUtf8().data(), time);
+
+        if (aPhase == QLatin1String("first-paint") && getenv("MOZ_STARTUP_TRACE")) {
+            WriteStartupTrace(QString::fromLocal8Bit(getenv("MOZ_STARTUP_TRACE")));
+        }
+    }
+
+    // Chrome trace event format, one complete event per phase
+    bool WriteStartupTrace(const QString& aPath)
+    {
+        QVariantList events;
+        Q_FOREACH(const QVariant& entry, mStartupTimeline) {
+            QVariantMap mark = entry.toMap();
+            qreal time = mark.value("time").toReal();
+            qreal delta = mark.value("delta").toReal();
+            QVariantMap event;
+            event.insert("name", mark.value("phase"));
+            event.insert("cat", QLatin1String("startup"));
+            event.insert("ph", QLatin1String("X"));
+            event.insert("ts", (time - delta) * 1000);
+            event.insert("dur", delta * 1000);
+            event.insert("pid", QCoreApplication::applicationPid());
+            event.insert("tid", 0);
+            events.append(event);
+        }
+        QVariantMap trace;
+        trace.insert("traceEvents", events);
+        trace.insert("displayTimeUnit", QLatin1String("ms"));
+        QString json;
+        MessageCodec::WriteJson(trace, json);
+
+        QFile file(aPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+            file.write(json.toUtf8()) < 0) {
+            LOGT("Failed to write startup trace %s: %s", aPath.toUtf8().data(), file.errorString().toUtf8().data());
+            return false;
+        }
+        return true;
+    }
+
     virtual uint32_t CreateNewWindowRequested(const uint32_t& chromeFlags, const char* uri, const uint32_t& contextFlags, EmbedLiteView* aParentView)
     {
         LOGT("QtMozEmbedContext new Window requested: parent:%p", aParentView);
@@ -155,7 +322,19 @@ public:
         return retval;
     }
 
-    QList<QString> mObserversList;
+    QHash<QByteArray, ObserverTopic> mObservers;
+    // Serialization buffer reused by sendObserve
+    QString mObserveBuffer;
+    GeckoThreadPolicy mThreadPolicy;
+    // Monotonic, started with the context
+    QElapsedTimer mStartupClock;
+    QVariantList mStartupTimeline;
+    QSet<QString> mStartupPhases;
+    // Set before initialization, applied in Initialized()
+    QVariantMap mPendingPrefs;
+    // Last value set per pref, repeated sets are skipped
+    QHash<QString, QVariant> mAppliedPrefs;
+    int mSkippedPrefs;
 private:
     QMozContext* q;
     EmbedLiteApp* mApp;
@@ -163,6 +342,8 @@ private:
     friend class QMozContext;
     QThread* mThread;
     bool mEmbedStarted;
+    FrameScheduler* mFrameScheduler;
+    ViewPool* mViewPool;
 };
 
 QMozContext::QMozContext(QObject* parent)
@@ -172,10 +353,35 @@ QMozContext::QMozContext(QObject* parent)
     Q_ASSERT(protectSingleton == nullptr);
     protectSingleton = this;
     LOGT("Create new Context: %p, parent:%p", (void*)this, (void*)parent);
-    setenv("BUILD_GRE_HOME", BUILD_GRE_HOME, 1);
-    LoadEmbedLite();
-    d->mApp = XRE_GetEmbedLite();
+    d->MarkStartupPhase("context-created");
+    if (sBootstrap) {
+        // Blocks only if preload() hasn't finished yet
+        sBootstrap->wait();
+        d->MarkStartupPhase("embedlite-loaded");
+        d->mApp = sBootstrap->mApp;
+        delete sBootstrap;
+        sBootstrap = nullptr;
+    } else {
+        setenv("BUILD_GRE_HOME", BUILD_GRE_HOME, 1);
+        LoadEmbedLite();
+        d->MarkStartupPhase("embedlite-loaded");
+        d->mApp = XRE_GetEmbedLite();
+    }
     d->mApp->SetListener(d);
+    d->MarkStartupPhase("app-created");
+}
+
+void
+QMozContext::preload()
+{
+    if (sBootstrap || protectSingleton) {
+        return;
+    }
+    LOGT("Start Gecko bootstrap");
+    // Environment is set here, the GUI thread may read it meanwhile
+    setenv("BUILD_GRE_HOME", BUILD_GRE_HOME, 1);
+    sBootstrap = new BootstrapThread();
+    sBootstrap->start();
 }
 
 QMozContext::~QMozContext()
@@ -193,15 +399,9 @@ QMozContext::sendObserve(const QString& aTopic, const QVariant& variant)
     if (!d->mApp)
         return;
 
-#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
-    QJson::Serializer serializer;
-    QByteArray array = serializer.serialize(variant);
-#else
-    QJsonDocument doc = QJsonDocument::fromVariant(variant);
-    QByteArray array = doc.toJson();
-#endif
-
-    d->mApp->SendObserve(aTopic.toUtf8().data(), (const PRUnichar*)QString(array).constData());
+    d->mObserveBuffer.truncate(0);
+    MessageCodec::WriteJson(variant, d->mObserveBuffer);
+    d->mApp->SendObserve(aTopic.toUtf8().data(), (const PRUnichar*)d->mObserveBuffer.constData());
 }
 
 void
@@ -224,12 +424,37 @@ QMozContext::addComponentManifest(const QString& manifestPath)
 void
 QMozContext::addObserver(const QString& aTopic)
 {
-    if (!d->IsInitialized()) {
-        d->mObserversList.append(aTopic);
+    QByteArray utf8 = aTopic.toUtf8();
+    ObserverTopic& topic = d->mObservers[utf8];
+    if (topic.mRefs++ > 0) {
         return;
     }
+    if (topic.mName.isEmpty()) {
+        topic.mName = aTopic;
+    }
+    // Before initialization Initialized() registers the topic
+    if (d->IsInitialized() && !topic.mRegistered) {
+        d->mApp->AddObserver(utf8.constData());
+        topic.mRegistered = true;
+    }
+}
 
-    d->mApp->AddObserver(aTopic.toUtf8().data());
+void
+QMozContext::removeObserver(const QString& aTopic)
+{
+    QHash<QByteArray, ObserverTopic>::iterator topic = d->mObservers.find(aTopic.toUtf8());
+    if (topic == d->mObservers.end() || topic->mRefs == 0) {
+        LOGT("topic:%s not observed", aTopic.toUtf8().data());
+        return;
+    }
+    if (--topic->mRefs > 0) {
+        return;
+    }
+    if (topic->mRegistered && d->IsInitialized()) {
+        d->mApp->RemoveObserver(topic.key().constData());
+        topic->mRegistered = false;
+    }
+    // Entry and its interned strings are kept for resubscription
 }
 
 QMozContext*
@@ -247,6 +472,7 @@ void QMozContext::runEmbedding(int aDelay)
 {
     if (!d->mEmbedStarted) {
         d->mEmbedStarted = true;
+        d->MarkStartupPhase("embedding-started");
         d->mApp->Start(EmbedLiteApp::EMBED_THREAD);
         d->mEmbedStarted = false;
     }
@@ -264,8 +490,21 @@ QMozContext::GetApp()
     return d->mApp;
 }
 
+FrameScheduler*
+QMozContext::GetFrameScheduler()
+{
+    return d->mFrameScheduler;
+}
+
+ViewPool*
+QMozContext::GetViewPool()
+{
+    return d->mViewPool;
+}
+
 void QMozContext::stopEmbedding()
 {
+    d->mViewPool->stop();
     GetApp()->Stop();
 }
 
@@ -298,33 +537,107 @@ QMozContext::setPref(const QString& aName, const QVariant& aPref)
 {
     LOGT("name:%s, type:%i", aName.toUtf8().data(), aPref.type());
     if (!d->mInitialized) {
-        LOGT("Error: context not yet initialized");
+        d->mPendingPrefs.insert(aName, aPref);
         return;
     }
-    switch (aPref.type()) {
-    case QVariant::String:
-        d->mApp->SetCharPref(aName.toUtf8().data(), aPref.toString().toUtf8().data());
-        break;
-    case QVariant::Int:
-    case QVariant::UInt:
-    case QVariant::LongLong:
-    case QVariant::ULongLong:
-        d->mApp->SetIntPref(aName.toUtf8().data(), aPref.toInt());
-        break;
-    case QVariant::Bool:
-        d->mApp->SetBoolPref(aName.toUtf8().data(), aPref.toBool());
-        break;
-    case QMetaType::Float:
-    case QMetaType::Double:
-        if (aPref.canConvert<int>()) {
-            d->mApp->SetIntPref(aName.toUtf8().data(), aPref.toInt());
+    d->ApplyPref(aName, aPref);
+}
+
+void
+QMozContext::setPrefs(const QVariantMap& aPrefs)
+{
+    LOGT("count:%i", aPrefs.size());
+    if (!d->mInitialized) {
+        if (d->mPendingPrefs.isEmpty()) {
+            d->mPendingPrefs = aPrefs;
         } else {
-            d->mApp->SetCharPref(aName.toUtf8().data(), aPref.toString().toUtf8().data());
+            QVariantMap::const_iterator pref = aPrefs.constBegin();
+            for (; pref != aPrefs.constEnd(); ++pref) {
+                d->mPendingPrefs.insert(pref.key(), pref.value());
+            }
         }
-        break;
-    default:
-        LOGT("Unknown pref type: %i", aPref.type());
+        return;
+    }
+    QVariantMap::const_iterator pref = aPrefs.constBegin();
+    for (; pref != aPrefs.constEnd(); ++pref) {
+        d->ApplyPref(pref.key(), pref.value());
+    }
+}
+
+int
+QMozContext::loadPrefsFile(const QString& aPath)
+{
+    QVariantMap prefs;
+    int count = PrefsFile::Load(aPath, prefs);
+    if (count > 0) {
+        setPrefs(prefs);
+    }
+    return count;
+}
+
+QVariantMap
+QMozContext::prefStatistics()
+{
+    QVariantMap stats;
+    stats.insert("pending", d->mPendingPrefs.size());
+    stats.insert("applied", d->mAppliedPrefs.size());
+    stats.insert("skipped", d->mSkippedPrefs);
+    return stats;
+}
+
+void
+QMozContext::setGeckoThreadPolicy(const QVariantMap& aPolicy)
+{
+    if (!d->mThreadPolicy.update(aPolicy)) {
+        LOGT("Invalid entries ignored");
+    }
+    // QThread priority first, it may reset the scheduling parameters
+    if (aPolicy.contains("priority") && d->mThread->isRunning()) {
+        d->mThread->setPriority(d->mThreadPolicy.priority());
     }
+    d->mThreadPolicy.apply();
+}
+
+void
+QMozContext::markStartupPhase(const QString& aPhase)
+{
+    d->MarkStartupPhase(aPhase);
+}
+
+QVariantList
+QMozContext::startupTimeline()
+{
+    return d->mStartupTimeline;
+}
+
+bool
+QMozContext::writeStartupTrace(const QString& aPath)
+{
+    return d->WriteStartupTrace(aPath);
+}
+
+void
+QMozContext::setViewPoolSize(int aSize)
+{
+    d->mViewPool->setCapacity(aSize);
+}
+
+int
+QMozContext::viewPoolSize()
+{
+    return d->mViewPool->capacity();
+}
+
+QVariantMap
+QMozContext::viewPoolStatistics()
+{
+    return d->mViewPool->statistics();
+}
+
+QVariantMap
+QMozContext::geckoThreadPolicy()
+{
+    return d->mThreadPolicy.toVariantMap();
 }
 
 void
@@ -336,3 +649,33 @@ QMozContext::notifyFirstUIInitialized()
         sCalledOnce = true;
     }
 }
+
+void
+QMozContext::setTargetFrameRate(int aFps)
+{
+    d->mFrameScheduler->setTargetFrameRate(aFps);
+}
+
+int
+QMozContext::targetFrameRate()
+{
+    return d->mFrameScheduler->targetFrameRate();
+}
+
+void
+QMozContext::setVsyncDriven(bool aVsyncDriven)
+{
+    d->mFrameScheduler->setVsyncDriven(aVsyncDriven);
+}
+
+void
+QMozContext::vsync()
+{
+    d->mFrameScheduler->vsync();
+}
+
+QVariantMap
+QMozContext::frameStatistics()
+{
+    return d->mFrameScheduler->statistics();
+}
@@ -11,6 +11,8 @@
 #include <QVariant>
 
 class QMozContextPrivate;
+class FrameScheduler;
+class ViewPool;
 
 namespace mozilla {
 namespace embedlite {
@@ -24,8 +26,15 @@ public:
     virtual ~QMozContext();
 
     mozilla::embedlite::EmbedLiteApp* GetApp();
+    FrameScheduler* GetFrameScheduler();
+    ViewPool* GetViewPool();
 
     static QMozContext* GetInstance();
+    // Loads Gecko and creates EmbedLiteApp on a background thread, so the
+    // GUI thread can build its scene meanwhile. GetInstance() waits for it
+    // only if it is still running. Call from the GUI thread before the
+    // context is created, e.g. first thing in main()
+    static void preload();
 
 Q_SIGNALS:
     void onInitialized();
@@ -37,7 +46,11 @@ public Q_SLOTS:
     void setIsAccelerated(bool aIsAccelerated);
     bool isAccelerated();
     void addComponentManifest(const QString& manifestPath);
+    // Subscriptions are counted per topic, Gecko stops sending a topic
+    // once every addObserver has been matched by removeObserver. Topics
+    // registered directly with GetApp()->AddObserver() are emitted too.
     void addObserver(const QString& aTopic);
+    void removeObserver(const QString& aTopic);
     quint32 newWindow(const QString& url, const quint32& parentId = 0);
     void sendObserve(const QString& aTopic, const QString& string);
     void sendObserve(const QString& aTopic, const QVariant& variant);
@@ -45,8 +58,41 @@ public Q_SLOTS:
     // and block this call until stopEmbedding called
     void runEmbedding(int aDelay = -1);
     void stopEmbedding();
+    // Prefs set before initialization are queued and applied together in
+    // Initialized(), setting the value a pref already has is skipped
     void setPref(const QString& aName, const QVariant& aPref);
+    void setPrefs(const QVariantMap& aPrefs);
+    // Applies a prefs.js style file, returns the number of prefs read or -1
+    int loadPrefsFile(const QString& aPath);
+    QVariantMap prefStatistics();
     void notifyFirstUIInitialized();
+    // Gecko thread scheduling: "priority" (QThread priority name, e.g. "low"),
+    // "nice", "affinity" (list of CPU indices), "scheduler" ("other", "fifo"
+    // or "rr") and "realtimePriority". Applies at once if Gecko is running
+    void setGeckoThreadPolicy(const QVariantMap& aPolicy);
+    QVariantMap geckoThreadPolicy();
+    // Initialized parentless views kept ready for new views, at most 4,
+    // 0 (the default) disables the pool
+    void setViewPoolSize(int aSize);
+    int viewPoolSize();
+    QVariantMap viewPoolStatistics();
+    // Startup phases with "time" since context creation and "delta" since
+    // the previous phase, in ms. Built-in phases run from "context-created"
+    // to "first-paint", applications may add their own
+    void markStartupPhase(const QString& aPhase);
+    QVariantList startupTimeline();
+    // Chrome trace event JSON, also written on first paint to
+    // MOZ_STARTUP_TRACE when set
+    bool writeStartupTrace(const QString& aPath);
+    // Repaints requested by views are paced to this rate, 0 disables pacing
+    void setTargetFrameRate(int aFps);
+    int targetFrameRate();
+    // When set, frames are issued when vsync() is called, connect it to the
+    // display's frame signal (e.g. QQuickWindow::frameSwapped). A frame
+    // requested while the display is idle is issued after 50 ms instead
+    void setVsyncDriven(bool aVsyncDriven);
+    void vsync();
+    QVariantMap frameStatistics();
 
 private:
     QMozContext(QObject* parent = 0);
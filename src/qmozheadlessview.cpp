@@ -0,0 +1,253 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-*/
+/* vim: set ts=2 sw=2 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#define LOG_COMPONENT "QMozHeadlessView"
+
+#include <QColor>
+#include <QEventLoop>
+#include <QTimer>
+
+#include "qmozheadlessview.h"
+#include "qmozcontext.h"
+#include "mozilla/embedlite/EmbedLog.h"
+#include "mozilla/embedlite/EmbedLiteApp.h"
+#include "mozilla/embedlite/EmbedLiteView.h"
+
+using namespace mozilla;
+using namespace mozilla::embedlite;
+
+class QMozHeadlessViewPrivate : public EmbedLiteViewListener
+{
+public:
+    QMozHeadlessViewPrivate(QMozHeadlessView* view)
+      : q(view)
+      , mContext(NULL)
+      , mView(NULL)
+      , mViewInitialized(false)
+      , mBgColor(Qt::white)
+      , mIsLoading(false)
+      , mIsPainted(false)
+      , mResizePending(false)
+      , mLoadGeneration(0)
+      , mStartedGeneration(0)
+    {
+    }
+
+    bool IsReady() const {
+        return mViewInitialized && mIsPainted && !mIsLoading && !mResizePending &&
+               IsCurrentLoad();
+    }
+    // Gecko reported the start of the last requested load. Until it does,
+    // paint and load finished notifications belong to the previous page.
+    bool IsCurrentLoad() const {
+        return mStartedGeneration == mLoadGeneration;
+    }
+    void CheckReady(bool aWasReady) {
+        if (!aWasReady && IsReady()) {
+            Q_EMIT q->ready();
+        }
+    }
+
+    virtual void ViewInitialized() {
+        mViewInitialized = true;
+        // Nothing shows the view, but inactive views do not paint
+        mView->SetIsActive(true);
+        mView->SetViewSize(mSize.width(), mSize.height());
+        Q_EMIT q->viewInitialized();
+        if (!mPendingUrl.isEmpty()) {
+            q->load(mPendingUrl);
+            mPendingUrl.clear();
+        }
+    }
+    virtual void ViewDestroyed() {
+        mView = NULL;
+        mViewInitialized = false;
+        Q_EMIT q->viewDestroyed();
+    }
+    virtual void SetBackgroundColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+        mBgColor = QColor(r, g, b, a);
+    }
+    virtual bool Invalidate() {
+        // First composite after a resize is the one with new geometry
+        bool wasReady = IsReady();
+        mResizePending = false;
+        CheckReady(wasReady);
+        return true;
+    }
+    virtual void OnLocationChanged(const char* aLocation, bool aCanGoBack, bool aCanGoForward) {
+        mLocation = QString(aLocation);
+        Q_EMIT q->urlChanged();
+    }
+    virtual void OnLoadStarted(const char* aLocation) {
+        mStartedGeneration = mLoadGeneration;
+        if (!mIsLoading) {
+            mIsLoading = true;
+            Q_EMIT q->loadingChanged();
+        }
+    }
+    virtual void OnLoadFinished(void) {
+        if (!IsCurrentLoad()) {
+            LOGT("Ignoring load finished of the previous page");
+            return;
+        }
+        bool wasReady = IsReady();
+        if (mIsLoading) {
+            mIsLoading = false;
+            Q_EMIT q->loadingChanged();
+        }
+        CheckReady(wasReady);
+    }
+    virtual void OnFirstPaint(int32_t aX, int32_t aY) {
+        if (!IsCurrentLoad()) {
+            LOGT("Ignoring first paint of the previous page");
+            return;
+        }
+        bool wasReady = IsReady();
+        mIsPainted = true;
+        CheckReady(wasReady);
+    }
+
+    QMozHeadlessView* q;
+    QMozContext* mContext;
+    EmbedLiteView* mView;
+    bool mViewInitialized;
+    QSize mSize;
+    QColor mBgColor;
+    QString mLocation;
+    QString mPendingUrl;
+    bool mIsLoading;
+    bool mIsPainted;
+    bool mResizePending;
+    // Bumped by every load(), OnLoadStarted catches mStartedGeneration up
+    quint32 mLoadGeneration;
+    quint32 mStartedGeneration;
+};
+
+QMozHeadlessView::QMozHeadlessView(const QSize& size, QObject* parent)
+    : QObject(parent)
+    , d(new QMozHeadlessViewPrivate(this))
+{
+    d->mSize = size;
+    d->mContext = QMozContext::GetInstance();
+    if (!d->mContext->initialized()) {
+        connect(d->mContext, SIGNAL(onInitialized()), this, SLOT(onInitialized()));
+    } else {
+        QTimer::singleShot(0, this, SLOT(onInitialized()));
+    }
+}
+
+QMozHeadlessView::~QMozHeadlessView()
+{
+    if (d->mView) {
+        d->mView->SetListener(NULL);
+        d->mContext->GetApp()->DestroyView(d->mView);
+    }
+    delete d;
+}
+
+void
+QMozHeadlessView::onInitialized()
+{
+    if (d->mContext->GetApp()->IsAccelerated()) {
+        LOGT("Context is accelerated, RenderToImage will not produce content");
+    }
+    if (!d->mView) {
+        d->mView = d->mContext->GetApp()->CreateView();
+        d->mView->SetListener(d);
+    }
+}
+
+quint32
+QMozHeadlessView::uniqueID() const
+{
+    return d->mView ? d->mView->GetUniqueID() : 0;
+}
+
+QUrl QMozHeadlessView::url() const
+{
+    return QUrl(d->mLocation);
+}
+
+QSize QMozHeadlessView::size() const
+{
+    return d->mSize;
+}
+
+void QMozHeadlessView::setSize(const QSize& size)
+{
+    if (d->mSize == size)
+        return;
+
+    d->mSize = size;
+    if (d->mViewInitialized) {
+        d->mResizePending = true;
+        d->mView->SetViewSize(size.width(), size.height());
+    }
+}
+
+bool QMozHeadlessView::loading() const
+{
+    return d->mIsLoading;
+}
+
+bool QMozHeadlessView::isReady() const
+{
+    return d->IsReady();
+}
+
+void QMozHeadlessView::load(const QString& url)
+{
+    if (url.isEmpty())
+        return;
+
+    if (!d->mViewInitialized) {
+        d->mPendingUrl = url;
+        return;
+    }
+    LOGT("url: %s", url.toUtf8().data());
+    // Content of the new page has to be painted before we are ready again
+    d->mIsPainted = false;
+    d->mLoadGeneration++;
+    d->mView->LoadURL(url.toUtf8().data());
+}
+
+void QMozHeadlessView::stop()
+{
+    if (!d->mViewInitialized)
+        return;
+    d->mView->StopLoad();
+}
+
+QImage QMozHeadlessView::snapshot()
+{
+    if (!d->mViewInitialized || d->mSize.isEmpty()) {
+        return QImage();
+    }
+    QImage image(d->mSize, QImage::Format_RGB32);
+    image.fill(d->mBgColor);
+    d->mView->RenderToImage(image.bits(), image.width(), image.height(),
+                            image.bytesPerLine(), image.depth());
+    return image;
+}
+
+QImage QMozHeadlessView::grab(const QSize& size, int timeout)
+{
+    setSize(size);
+    if (!d->IsReady()) {
+        QEventLoop loop;
+        QTimer timer;
+        timer.setSingleShot(true);
+        connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
+        connect(this, SIGNAL(ready()), &loop, SLOT(quit()));
+        timer.start(timeout);
+        loop.exec();
+    }
+    if (!d->IsReady()) {
+        LOGT("View not ready after %i ms", timeout);
+        return QImage();
+    }
+    return snapshot();
+}
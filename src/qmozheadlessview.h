@@ -0,0 +1,67 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-*/
+/* vim: set ts=2 sw=2 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef qmozheadlessview_h
+#define qmozheadlessview_h
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QUrl>
+
+class QMozHeadlessViewPrivate;
+
+/*!
+ * View rendering page content with EmbedLiteView::RenderToImage, without
+ * any widget, graphics scene or window. Meant for page snapshots, the
+ * context has to be in software (non accelerated) mode.
+ */
+class QMozHeadlessView : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QUrl url READ url NOTIFY urlChanged)
+    Q_PROPERTY(QSize size READ size WRITE setSize)
+    Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
+    Q_PROPERTY(bool ready READ isReady NOTIFY ready)
+
+public:
+    QMozHeadlessView(const QSize& size = QSize(800, 600), QObject* parent = 0);
+    virtual ~QMozHeadlessView();
+
+    QUrl url() const;
+    QSize size() const;
+    void setSize(const QSize& size);
+    bool loading() const;
+    // View painted the current page and finished loading it
+    bool isReady() const;
+
+public Q_SLOTS:
+    void load(const QString& url);
+    void stop();
+    quint32 uniqueID() const;
+    // Renders the current content right away
+    QImage snapshot();
+    // Resizes the view if needed, waits until it is ready (running a local
+    // event loop) and renders it. Returns null image on timeout.
+    QImage grab(const QSize& size, int timeout = 30000);
+
+Q_SIGNALS:
+    void viewInitialized();
+    void urlChanged();
+    void loadingChanged();
+    void ready();
+    void viewDestroyed();
+
+private Q_SLOTS:
+    void onInitialized();
+
+private:
+    QMozHeadlessViewPrivate* d;
+    friend class QMozHeadlessViewPrivate;
+};
+
+#endif /* qmozheadlessview_h */
@@ -0,0 +1,116 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-*/
+/* vim: set ts=2 sw=2 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#define LOG_COMPONENT "QMozSnapshotQueue"
+
+#include <QTimer>
+
+#include "qmozsnapshotqueue.h"
+#include "qmozheadlessview.h"
+#include "mozilla/embedlite/EmbedLog.h"
+
+QMozSnapshotQueue::QMozSnapshotQueue(int viewCount, const QSize& size, QObject* parent)
+    : QObject(parent)
+    , mTimeout(30000)
+{
+    for (int i = 0; i < qMax(1, viewCount); ++i) {
+        QMozHeadlessView* view = new QMozHeadlessView(size, this);
+        connect(view, SIGNAL(viewInitialized()), this, SLOT(onViewInitialized()));
+        connect(view, SIGNAL(ready()), this, SLOT(onViewReady()));
+        QTimer* timer = new QTimer(view);
+        timer->setSingleShot(true);
+        connect(timer, SIGNAL(timeout()), this, SLOT(onTimeout()));
+        mTimers.insert(view, timer);
+        mViews.append(view);
+    }
+}
+
+QMozSnapshotQueue::~QMozSnapshotQueue()
+{
+}
+
+void QMozSnapshotQueue::setTimeout(int timeout)
+{
+    mTimeout = timeout;
+}
+
+int QMozSnapshotQueue::pending() const
+{
+    return mQueue.size() + mActive.size();
+}
+
+void QMozSnapshotQueue::enqueue(const QString& url)
+{
+    mQueue.enqueue(url);
+    dispatch();
+}
+
+void QMozSnapshotQueue::enqueue(const QStringList& urls)
+{
+    Q_FOREACH(const QString& url, urls) {
+        mQueue.enqueue(url);
+    }
+    dispatch();
+}
+
+void QMozSnapshotQueue::dispatch()
+{
+    Q_FOREACH(QMozHeadlessView* view, mViews) {
+        if (mQueue.isEmpty()) {
+            break;
+        }
+        if (mActive.contains(view) || !mInitialized.contains(view)) {
+            continue;
+        }
+        QString url = mQueue.dequeue();
+        LOGT("view:%u, url:%s", view->uniqueID(), url.toUtf8().data());
+        mActive.insert(view, url);
+        mTimers.value(view)->start(mTimeout);
+        view->load(url);
+    }
+}
+
+void QMozSnapshotQueue::complete(QMozHeadlessView* view, const QImage& image)
+{
+    QString url = mActive.take(view);
+    mTimers.value(view)->stop();
+    if (image.isNull()) {
+        view->stop();
+        Q_EMIT snapshotFailed(url);
+    } else {
+        Q_EMIT snapshotReady(url, image);
+    }
+    dispatch();
+    if (mQueue.isEmpty() && mActive.isEmpty()) {
+        Q_EMIT finished();
+    }
+}
+
+void QMozSnapshotQueue::onViewInitialized()
+{
+    QMozHeadlessView* view = qobject_cast<QMozHeadlessView*>(sender());
+    if (view) {
+        mInitialized.insert(view);
+    }
+    dispatch();
+}
+
+void QMozSnapshotQueue::onViewReady()
+{
+    QMozHeadlessView* view = qobject_cast<QMozHeadlessView*>(sender());
+    if (view && mActive.contains(view)) {
+        complete(view, view->snapshot());
+    }
+}
+
+void QMozSnapshotQueue::onTimeout()
+{
+    QMozHeadlessView* view = qobject_cast<QMozHeadlessView*>(sender()->parent());
+    if (view && mActive.contains(view)) {
+        LOGT("Timeout for url:%s", mActive.value(view).toUtf8().data());
+        complete(view, QImage());
+    }
+}
@@ -0,0 +1,65 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-*/
+/* vim: set ts=2 sw=2 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef qmozsnapshotqueue_h
+#define qmozsnapshotqueue_h
+
+#include <QObject>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QQueue>
+#include <QSet>
+#include <QSize>
+#include <QStringList>
+
+class QMozHeadlessView;
+class QTimer;
+
+/*!
+ * Renders queued URLs one after another with a fixed set of reused
+ * QMozHeadlessView instances, without blocking the caller.
+ */
+class QMozSnapshotQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    QMozSnapshotQueue(int viewCount = 1, const QSize& size = QSize(800, 600), QObject* parent = 0);
+    virtual ~QMozSnapshotQueue();
+
+    // Time a single page may take before it is reported as failed
+    void setTimeout(int timeout);
+    int pending() const;
+
+public Q_SLOTS:
+    void enqueue(const QString& url);
+    void enqueue(const QStringList& urls);
+
+Q_SIGNALS:
+    void snapshotReady(const QString& url, const QImage& image);
+    void snapshotFailed(const QString& url);
+    // Queue is empty and all views are idle
+    void finished();
+
+private Q_SLOTS:
+    void onViewInitialized();
+    void onViewReady();
+    void onTimeout();
+
+private:
+    void dispatch();
+    void complete(QMozHeadlessView* view, const QImage& image);
+
+    QList<QMozHeadlessView*> mViews;
+    QSet<QMozHeadlessView*> mInitialized;
+    QHash<QMozHeadlessView*, QString> mActive;
+    QHash<QMozHeadlessView*, QTimer*> mTimers;
+    QQueue<QString> mQueue;
+    int mTimeout;
+};
+
+#endif /* qmozsnapshotqueue_h */
@@ -2,70 +2,197 @@
 
 #include "mozilla-config.h"
 #include "qmozcontext.h"
+#include "framescheduler.h"
+#include "viewpool.h"
+#include "latencyhistogram.h"
 #include "InputData.h"
 #include "mozilla/embedlite/EmbedLog.h"
 #include "mozilla/embedlite/EmbedLiteView.h"
 #include "mozilla/embedlite/EmbedLiteApp.h"
 
 #include <QTimer>
+#include <QPointer>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QtOpenGL/QGLContext>
 #include <QApplication>
 #include <QtQuick/qquickwindow.h>
 #include <QtGui/QOpenGLShaderProgram>
 #include <QtGui/QOpenGLContext>
-#include <QSGSimpleRectNode>
+#include <QtGui/QOpenGLFramebufferObject>
+#include <QSGSimpleTextureNode>
 
 using namespace mozilla;
 using namespace mozilla::embedlite;
 
-class QuickMozViewPrivate : public EmbedLiteViewListener {
+/*!
+ * Scene graph node showing view content. It owns the FBO Gecko composites
+ * into, or the image RenderToImage fills in software mode, so both are
+ * released on the render thread together with the node.
+ */
+class MozContentNode : public QSGSimpleTextureNode
+{
+public:
+    MozContentNode()
+      : mFbo(NULL)
+      , mTexture(NULL)
+    {
+    }
+    virtual ~MozContentNode() {
+        delete mTexture;
+        delete mFbo;
+    }
+
+    void setContentTexture(QSGTexture* aTexture) {
+        setTexture(aTexture);
+        delete mTexture;
+        mTexture = aTexture;
+    }
+
+    QOpenGLFramebufferObject* mFbo;
+    QSGTexture* mTexture;
+    QImage mImage;
+};
+
+/*!
+ * Everything the render pass needs, copied in updatePaintNode while the GUI
+ * thread is blocked. Only the render thread touches it.
+ */
+struct MozRenderState
+{
+    MozRenderState()
+      : mNode(NULL)
+      , mAccelerated(false)
+    {
+    }
+
+    QSize mSize;
+    MozContentNode* mNode;
+    bool mAccelerated;
+};
+
+/*!
+ * Forwards the window's render thread signals to a view. It is parented to
+ * the window rather than the view: a view can be destroyed on the GUI thread
+ * while beforeRendering is being emitted, so the view only detaches itself
+ * under the mutex and the hook disconnects and retires from the render thread.
+ */
+class QuickMozRenderHook : public QObject
+{
+    Q_OBJECT
+public:
+    QuickMozRenderHook(QQuickWindow* aWindow, QuickMozView* aView)
+      : QObject(aWindow)
+      , mView(aView)
+    {
+        connect(aWindow, SIGNAL(beforeRendering()), this, SLOT(beforeRendering()), Qt::DirectConnection);
+        connect(aWindow, SIGNAL(sceneGraphInvalidated()), this, SLOT(sceneGraphInvalidated()), Qt::DirectConnection);
+    }
+
+    // GUI thread, waits for a render pass in flight to finish
+    void detach() {
+        QMutexLocker lock(&mMutex);
+        mView = NULL;
+    }
+
+public Q_SLOTS:
+    void beforeRendering() {
+        QMutexLocker lock(&mMutex);
+        if (mView) {
+            mView->paint();
+        } else {
+            retire();
+        }
+    }
+    void sceneGraphInvalidated() {
+        QMutexLocker lock(&mMutex);
+        if (mView) {
+            mView->cleanup();
+        } else {
+            retire();
+        }
+    }
+
+private:
+    void retire() {
+        // Emission happens on this thread, so nothing reaches us after this
+        disconnect(parent(), 0, this, 0);
+        deleteLater();
+    }
+
+    QMutex mMutex;
+    QuickMozView* mView;
+};
+
+class QuickMozViewPrivate : public EmbedLiteViewListener
+                          , public FrameSchedulerClient {
 public:
     QuickMozViewPrivate(QuickMozView* view)
       : q(view)
       , mContext(NULL)
       , mView(NULL)
       , mViewInitialized(false)
-      , mViewGLSized(false)
+      , mBgColor(Qt::white)
     {
     }
-    virtual ~QuickMozViewPrivate() {}
+    virtual ~QuickMozViewPrivate() {
+        if (mContext) {
+            mContext->GetFrameScheduler()->removeClient(this);
+        }
+    }
 
-    void UpdateViewSize(bool updateSize = true)
+    void UpdateViewSize()
     {
         if (mViewInitialized) {
-            if (mContext->GetApp()->IsAccelerated()) {
-                const QOpenGLContext* ctx = QOpenGLContext::currentContext();
-                if (ctx && ctx->surface()) {
-                    QRectF r(0, 0, ctx->surface()->size().width(), ctx->surface()->size().height());
-                    r = q->mapRectToScene(r);
-                    mView->SetGLViewPortSize(r.width(), r.height());
-                }
-            }
+            QMutexLocker lock(&mViewMutex);
             mView->SetViewSize(q->boundingRect().width(), q->boundingRect().height());
         }
     }
     virtual void ViewInitialized() {
         mViewInitialized = true;
+        mContext->markStartupPhase("first-view-initialized");
         UpdateViewSize();
         mView->LoadURL("about:mozilla");
     }
+    virtual void SetBackgroundColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+        mBgColor = QColor(r, g, b, a);
+    }
+    virtual void OnFirstPaint(int32_t aX, int32_t aY) {
+        mContext->markStartupPhase("first-paint");
+    }
     virtual bool Invalidate() {
-        q->update();
+        mContext->GetFrameScheduler()->scheduleFrame(this);
         return true;
     }
+    virtual void ScheduledFrame() {
+        q->update();
+    }
+    virtual bool IsFrameActive() const {
+        return q->isVisible();
+    }
 
     QuickMozView* q;
     QMozContext* mContext;
     EmbedLiteView* mView;
     bool mViewInitialized;
-    bool mViewGLSized;
+    QColor mBgColor;
+    QPointer<QuickMozRenderHook> mRenderHook;
+    LatencyHistogram mRenderGLTime;
+    LatencyHistogram mRenderToImageTime;
+    // Held by RenderGL on the render thread and by GUI thread calls that
+    // change view geometry. Viewport, transform and clipping are set during
+    // sync instead, while the GUI thread is blocked
+    QMutex mViewMutex;
+    // Render thread only
+    MozRenderState mRenderState;
+    QSize mGLViewPortSize;
 };
 
 QuickMozView::QuickMozView(QQuickItem *parent)
   : QQuickItem(parent)
   , d(new QuickMozViewPrivate(this))
 {
-//    setFlag(ItemHasContents, true);
+    setFlag(ItemHasContents, true);
     d->mContext = QMozContext::GetInstance();
     if (!d->mContext->initialized()) {
         connect(d->mContext, SIGNAL(onInitialized()), this, SLOT(onInitialized()));
@@ -76,6 +203,10 @@ QuickMozView::QuickMozView(QQuickItem *parent)
 
 QuickMozView::~QuickMozView()
 {
+    // Once detached no render pass can reach d or the scene graph node
+    if (d->mRenderHook) {
+        d->mRenderHook->detach();
+    }
     delete d;
 }
 
@@ -83,60 +214,137 @@ void
 QuickMozView::onInitialized()
 {
     LOGT("QuickMozView");
-    d->mContext->GetApp()->SetIsAccelerated(true);
-    d->mView = d->mContext->GetApp()->CreateView();
+    // Software rendering lets the view run without a GPU, e.g. on llvmpipe
+    if (!getenv("USE_SW_RENDERING")) {
+        d->mContext->GetApp()->SetIsAccelerated(true);
+    }
+    bool initialized = false;
+    d->mView = d->mContext->GetViewPool()->take(&initialized);
+    if (!d->mView) {
+        d->mView = d->mContext->GetApp()->CreateView();
+    }
     d->mView->SetListener(d);
+    d->mContext->markStartupPhase("first-view-created");
+    if (initialized) {
+        d->ViewInitialized();
+    }
 }
 
 void QuickMozView::itemChange(ItemChange change, const ItemChangeData &)
 {
     if (change == ItemSceneChange) {
+        if (d->mRenderHook) {
+            d->mRenderHook->detach();
+            d->mRenderHook = NULL;
+        }
         QQuickWindow *win = window();
         if (!win)
             return;
-        connect(win, SIGNAL(beforeRendering()), this, SLOT(paint()), Qt::DirectConnection);
-        win->setClearBeforeRendering(false);
+        // Gecko composites after sync, while GUI thread is already free again
+        d->mRenderHook = new QuickMozRenderHook(win, this);
     }
 }
 
-
 void QuickMozView::paint()
 {
-    if (d->mViewInitialized) {
-        if (d->mContext->GetApp()->IsAccelerated()) {
-            if (!d->mViewGLSized) {
-                d->UpdateViewSize(false);
-                d->mViewGLSized = true;
-            }
-            QMatrix qmatr;
-            qmatr.translate(x(), y());
-            qmatr.rotate(rotation());
-            qmatr.scale(scale(), scale());
-            gfxMatrix matr(qmatr.m11(), qmatr.m12(), qmatr.m21(), qmatr.m22(), qmatr.dx(), qmatr.dy());
-            d->mView->SetGLViewTransform(matr);
-            d->mView->SetViewClipping(0, 0, boundingRect().width(), boundingRect().height());
-            d->mView->RenderGL();
-        }
+    // Runs on the render thread while the GUI thread is free again, only
+    // RenderGL under the view mutex and the snapshot may be used here
+    const MozRenderState& state = d->mRenderState;
+    if (!state.mAccelerated || !state.mNode || !state.mNode->mFbo) {
+        return;
+    }
+    state.mNode->mFbo->bind();
+    {
+        QMutexLocker lock(&d->mViewMutex);
+        LatencyScope scope(d->mRenderGLTime);
+        d->mView->RenderGL();
     }
+    state.mNode->mFbo->release();
 }
 
-void QuickMozView::geometryChanged(const QRectF & newGeometry, const QRectF&)
+void QuickMozView::geometryChanged(const QRectF & newGeometry, const QRectF & oldGeometry)
 {
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
     d->UpdateViewSize();
 }
 
 QSGNode*
 QuickMozView::updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data)
 {
-    QSGSimpleRectNode *n = static_cast<QSGSimpleRectNode *>(oldNode);
+    // GUI thread is blocked while the scene graph syncs, so it is safe to
+    // report the frame and take the render state snapshot from here
+    d->mContext->GetFrameScheduler()->framePresented(d);
+
+    MozContentNode* n = static_cast<MozContentNode*>(oldNode);
+    QSize size = boundingRect().size().toSize();
+    if (!d->mViewInitialized || size.isEmpty()) {
+        delete n;
+        d->mRenderState = MozRenderState();
+        return 0;
+    }
     if (!n) {
-        n = new QSGSimpleRectNode();
-        n->setColor(Qt::green);
+        n = new MozContentNode();
+    }
+    d->mRenderState.mSize = size;
+    d->mRenderState.mNode = n;
+    d->mRenderState.mAccelerated = d->mContext->GetApp()->IsAccelerated();
+
+    if (d->mRenderState.mAccelerated) {
+        if (d->mGLViewPortSize != size) {
+            d->mGLViewPortSize = size;
+            d->mView->SetGLViewPortSize(size.width(), size.height());
+        }
+        // Content is composited into our FBO, so no item transform is needed
+        // here, scene graph positions the texture
+        d->mView->SetGLViewTransform(gfxMatrix());
+        d->mView->SetViewClipping(0, 0, size.width(), size.height());
+        if (!n->mFbo || n->mFbo->size() != size) {
+            QOpenGLFramebufferObject* oldFbo = n->mFbo;
+            n->mFbo = new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+            n->setContentTexture(window()->createTextureFromId(n->mFbo->texture(), size));
+            delete oldFbo;
+        }
+        // FBO content is bottom-up
+        n->setRect(QRectF(0, size.height(), size.width(), -size.height()));
+    } else {
+        // Texture upload has to happen during sync, so software frames are
+        // still rendered here
+        if (n->mImage.size() != size) {
+            n->mImage = QImage(size, QImage::Format_RGB32);
+        }
+        n->mImage.fill(d->mBgColor);
+        {
+            LatencyScope scope(d->mRenderToImageTime);
+            d->mView->RenderToImage(n->mImage.bits(), n->mImage.width(), n->mImage.height(),
+                                    n->mImage.bytesPerLine(), n->mImage.depth());
+        }
+        n->setContentTexture(window()->createTextureFromImage(n->mImage));
+        n->setRect(boundingRect());
     }
-    n->setRect(boundingRect());
+    n->markDirty(QSGNode::DirtyMaterial);
     return n;
 }
 
 void QuickMozView::cleanup()
 {
+    // Scene graph deletes the nodes, the next frame starts from scratch
+    d->mRenderState = MozRenderState();
+    d->mGLViewPortSize = QSize();
+}
+
+QVariantMap QuickMozView::renderStatistics() const
+{
+    QVariantMap stats;
+    stats.insert("RenderGL", d->mRenderGLTime.toVariantMap());
+    stats.insert("RenderToImage", d->mRenderToImageTime.toVariantMap());
+    return stats;
 }
+
+void QuickMozView::dumpRenderStatistics()
+{
+    QByteArray prefix = QString("View %1").arg(d->mView ? d->mView->GetUniqueID() : 0).toUtf8();
+    d->mRenderGLTime.dump((prefix + " RenderGL").constData());
+    d->mRenderToImageTime.dump((prefix + " RenderToImage").constData());
+}
+
+#include "quickmozview.moc"
@@ -8,11 +8,14 @@ class QuickMozViewPrivate;
 class QuickMozView : public QQuickItem
 {
     Q_OBJECT
+    Q_PROPERTY(QVariantMap renderStatistics READ renderStatistics)
 
 public:
     QuickMozView(QQuickItem *parent = 0);
     ~QuickMozView();
 
+    QVariantMap renderStatistics() const;
+
 protected:
     void itemChange(ItemChange change, const ItemChangeData &);
     virtual void geometryChanged(const QRectF & newGeometry, const QRectF & oldGeometry);
@@ -22,6 +25,7 @@ protected:
 public Q_SLOTS:
     void paint();
     void cleanup();
+    void dumpRenderStatistics();
 
 private Q_SLOTS:
     void onInitialized();
@@ -0,0 +1,165 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#define LOG_COMPONENT "RenderWorker"
+
+#include <QMutexLocker>
+#include <QPainter>
+#include <QThread>
+
+#include "renderworker.h"
+#include "latencyhistogram.h"
+#include "mozilla/embedlite/EmbedLog.h"
+#include "mozilla/embedlite/EmbedLiteView.h"
+
+using namespace mozilla::embedlite;
+
+static const int kIndexMask = 0x3;
+static const int kNewFrame = 0x4;
+
+RenderWorker::RenderWorker(EmbedLiteView* aView, LatencyHistogram* aRenderTime, QObject* parent)
+    : QObject(parent)
+    , mView(aView)
+    , mRenderTime(aRenderTime)
+    , mThread(NULL)
+    , mBackIndex(0)
+    , mFrontIndex(1)
+    , mReady(2)
+    , mRenderPending(0)
+    , mFramesProduced(0)
+    , mFramesPresented(0)
+    , mViewMutex(QMutex::Recursive)
+    , mBgColor(Qt::white)
+    , mFormat(QImage::Format_RGB16)
+{
+}
+
+RenderWorker::~RenderWorker()
+{
+    stop();
+}
+
+void RenderWorker::start()
+{
+    if (mThread) {
+        return;
+    }
+    mThread = new QThread();
+    moveToThread(mThread);
+    mThread->start();
+    LOGT("Render thread started: %p", mThread);
+}
+
+void RenderWorker::stop()
+{
+    if (!mThread) {
+        return;
+    }
+    LOGT("Stop render thread: %p", mThread);
+    mThread->exit(0);
+    mThread->wait();
+    delete mThread;
+    mThread = NULL;
+}
+
+void RenderWorker::setViewSize(const QSize& aSize)
+{
+    QMutexLocker lock(&mConfigMutex);
+    mSize = aSize;
+}
+
+void RenderWorker::setBackgroundColor(const QColor& aColor)
+{
+    QMutexLocker lock(&mConfigMutex);
+    mBgColor = aColor;
+}
+
+void RenderWorker::setImageFormat(QImage::Format aFormat)
+{
+    {
+        QMutexLocker lock(&mConfigMutex);
+        if (mFormat == aFormat) {
+            return;
+        }
+        mFormat = aFormat;
+    }
+    requestFrame();
+}
+
+void RenderWorker::requestFrame()
+{
+    if (mThread && mRenderPending.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "render", Qt::QueuedConnection);
+    }
+}
+
+bool RenderWorker::takeFrame()
+{
+    if (!(mReady.fetchAndAddOrdered(0) & kNewFrame)) {
+        return false;
+    }
+    int ready = mReady.fetchAndStoreOrdered(mFrontIndex);
+    mFrontIndex = ready & kIndexMask;
+    mFramesPresented.fetchAndAddOrdered(1);
+    return true;
+}
+
+const QImage& RenderWorker::frontBuffer() const
+{
+    return mBuffers[mFrontIndex];
+}
+
+QMutex* RenderWorker::viewMutex()
+{
+    return &mViewMutex;
+}
+
+int RenderWorker::framesProduced() const
+{
+    return const_cast<QAtomicInt&>(mFramesProduced).fetchAndAddOrdered(0);
+}
+
+int RenderWorker::framesPresented() const
+{
+    return const_cast<QAtomicInt&>(mFramesPresented).fetchAndAddOrdered(0);
+}
+
+void RenderWorker::render()
+{
+    // Clear the flag first, so invalidations arriving while Gecko renders
+    // queue one more frame instead of getting lost
+    mRenderPending.fetchAndStoreOrdered(0);
+
+    QSize size;
+    QColor bgColor;
+    QImage::Format format;
+    {
+        QMutexLocker lock(&mConfigMutex);
+        size = mSize;
+        bgColor = mBgColor;
+        format = mFormat;
+    }
+    if (size.isEmpty()) {
+        return;
+    }
+
+    QImage& back = mBuffers[mBackIndex];
+    if (back.size() != size || back.format() != format) {
+        back = QImage(size, format);
+    }
+    back.fill(bgColor);
+    {
+        QMutexLocker viewLock(&mViewMutex);
+        LatencyScope scope(*mRenderTime);
+        mView->RenderToImage(back.bits(), back.width(), back.height(),
+                             back.bytesPerLine(), back.depth());
+    }
+
+    int ready = mReady.fetchAndStoreOrdered(mBackIndex | kNewFrame);
+    mBackIndex = ready & kIndexMask;
+    mFramesProduced.fetchAndAddOrdered(1);
+    Q_EMIT frameReady();
+}
@@ -0,0 +1,96 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef RENDERWORKER_H
+#define RENDERWORKER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QColor>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+
+class QThread;
+class LatencyHistogram;
+
+namespace mozilla {
+namespace embedlite {
+class EmbedLiteView;
+}}
+
+/*!
+ * Renders EmbedLiteView content with RenderToImage from its own thread.
+ *
+ * Frames go through three buffers: the worker thread renders into the back
+ * buffer, publishes it as the ready buffer with an atomic exchange, and the
+ * GUI thread takes the ready buffer as its front buffer the same way. Neither
+ * side ever waits for the other on frames.
+ *
+ * RenderToImage reads the view size, viewport and transform of the
+ * compositor, so SetViewSize, SetGLViewPortSize, SetGLViewTransform and
+ * SetViewClipping must hold viewMutex(). Everything else the GUI thread
+ * calls on the view (loading, navigation, SetIsActive, input, messages)
+ * only queues IPC to the content side and runs concurrently with rendering.
+ */
+class RenderWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    RenderWorker(mozilla::embedlite::EmbedLiteView* aView, LatencyHistogram* aRenderTime,
+                 QObject* parent = 0);
+    virtual ~RenderWorker();
+
+    // Following methods are called from the GUI thread
+    void start();
+    void stop();
+    void setViewSize(const QSize& aSize);
+    void setBackgroundColor(const QColor& aColor);
+    void setImageFormat(QImage::Format aFormat);
+    // Coalesced: at most one render is queued at any time
+    void requestFrame();
+    // Makes the latest completed frame the front buffer, returns false if
+    // there was no new frame since the last call
+    bool takeFrame();
+    const QImage& frontBuffer() const;
+    // Held while the worker renders, GUI thread calls changing view geometry
+    // must hold it too. Recursive, so nested GUI thread helpers can lock again
+    QMutex* viewMutex();
+
+    int framesProduced() const;
+    int framesPresented() const;
+
+Q_SIGNALS:
+    // Emitted from the render thread once a frame is ready to be taken
+    void frameReady();
+
+private Q_SLOTS:
+    void render();
+
+private:
+    mozilla::embedlite::EmbedLiteView* mView;
+    LatencyHistogram* mRenderTime;
+    QThread* mThread;
+    QImage mBuffers[3];
+    // Owned by the render thread
+    int mBackIndex;
+    // Owned by the GUI thread
+    int mFrontIndex;
+    // Index of the last completed buffer, kNewFrame set until it is taken
+    QAtomicInt mReady;
+    QAtomicInt mRenderPending;
+    QAtomicInt mFramesProduced;
+    QAtomicInt mFramesPresented;
+    QMutex mViewMutex;
+    // Protects frame configuration only, never held while rendering
+    QMutex mConfigMutex;
+    QSize mSize;
+    QColor mBgColor;
+    QImage::Format mFormat;
+};
+
+#endif
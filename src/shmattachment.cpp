@@ -0,0 +1,92 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QAtomicInt>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shmattachment.h"
+#include "mozilla/embedlite/EmbedLog.h"
+
+static QAtomicInt sNextAttachmentId(1);
+
+ShmAttachment::ShmAttachment(quint32 aId, const QByteArray& aName, int aSize)
+    : mId(aId)
+    , mName(aName)
+    , mSize(aSize)
+    , mSenderReleased(false)
+    , mContentReleased(false)
+{
+    mDescriptor.insert("attachment", mId);
+    // Where POSIX shared memory objects show up on Linux
+    mDescriptor.insert("path", QString::fromLatin1("/dev/shm" + mName));
+    mDescriptor.insert("size", mSize);
+}
+
+ShmAttachment::~ShmAttachment()
+{
+    shm_unlink(mName.constData());
+}
+
+ShmAttachment* ShmAttachment::Create(const uchar* aData, int aSize)
+{
+    quint32 id = sNextAttachmentId.fetchAndAddRelaxed(1);
+    QByteArray name = "/qtmozembed-" + QByteArray::number(getpid()) + "-" + QByteArray::number(id);
+
+    int fd = shm_open(name.constData(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        LOGT("shm_open failed for %s", name.constData());
+        return NULL;
+    }
+    if (aSize > 0) {
+        void* mem = MAP_FAILED;
+        if (ftruncate(fd, aSize) == 0) {
+            mem = mmap(NULL, aSize, PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (mem == MAP_FAILED) {
+            LOGT("failed to map %i bytes", aSize);
+            close(fd);
+            shm_unlink(name.constData());
+            return NULL;
+        }
+        memcpy(mem, aData, aSize);
+        munmap(mem, aSize);
+    }
+    close(fd);
+    return new ShmAttachment(id, name, aSize);
+}
+
+ShmAttachment* ShmAttachment::Create(const QByteArray& aData)
+{
+    return Create(reinterpret_cast<const uchar*>(aData.constData()), aData.size());
+}
+
+ShmAttachment* ShmAttachment::Create(const QImage& aImage)
+{
+    // One known layout for the content side, native endian 0xAARRGGBB words
+    QImage image = aImage.convertToFormat(QImage::Format_ARGB32);
+    ShmAttachment* attachment = Create(image.constBits(), image.byteCount());
+    if (attachment) {
+        attachment->mDescriptor.insert("width", image.width());
+        attachment->mDescriptor.insert("height", image.height());
+        attachment->mDescriptor.insert("stride", image.bytesPerLine());
+        attachment->mDescriptor.insert("format", QString("ARGB32"));
+    }
+    return attachment;
+}
+
+bool ShmAttachment::release(Side aSide)
+{
+    if (aSide == Sender) {
+        mSenderReleased = true;
+    } else {
+        mContentReleased = true;
+    }
+    return mSenderReleased && mContentReleased;
+}
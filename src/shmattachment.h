@@ -0,0 +1,55 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef SHMATTACHMENT_H
+#define SHMATTACHMENT_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QVariantMap>
+
+/*!
+ * Message payload data placed in a POSIX shared memory object.
+ *
+ * Messages carry only descriptor(), frame scripts read the object as an
+ * ArrayBuffer with MessageCodec.readAttachment() from messagecodec.js. The
+ * object is unlinked once both the sender and content released it, repeated
+ * releases from one side are ignored.
+ */
+class ShmAttachment
+{
+public:
+    enum Side {
+        Sender,
+        Content
+    };
+
+    // Returns NULL if the shared memory object could not be created
+    static ShmAttachment* Create(const QByteArray& aData);
+    static ShmAttachment* Create(const QImage& aImage);
+    ~ShmAttachment();
+
+    quint32 id() const { return mId; }
+    int size() const { return mSize; }
+    // {attachment: id, path, size} plus geometry for images
+    QVariantMap descriptor() const { return mDescriptor; }
+
+    // Returns true when both sides released it and it can be deleted
+    bool release(Side aSide);
+
+private:
+    ShmAttachment(quint32 aId, const QByteArray& aName, int aSize);
+    static ShmAttachment* Create(const uchar* aData, int aSize);
+
+    quint32 mId;
+    QByteArray mName;
+    int mSize;
+    bool mSenderReleased;
+    bool mContentReleased;
+    QVariantMap mDescriptor;
+};
+
+#endif
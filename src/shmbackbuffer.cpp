@@ -0,0 +1,235 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#define LOG_COMPONENT "ShmBackBuffer"
+
+#include <QPainter>
+#include <QPaintEngine>
+#include <QPixmap>
+#include <QVarLengthArray>
+#if defined(Q_WS_X11)
+#include <QX11Info>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#endif
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "shmbackbuffer.h"
+#include "mozilla/embedlite/EmbedLog.h"
+
+#if defined(Q_WS_X11)
+static bool sShmAttachFailed = false;
+
+// XShmAttach succeeds locally and fails asynchronously on remote displays
+static int ShmAttachErrorHandler(Display*, XErrorEvent*)
+{
+    sShmAttachFailed = true;
+    return 0;
+}
+
+static bool AttachShm(Display* aDisplay, XShmSegmentInfo* aInfo)
+{
+    sShmAttachFailed = false;
+    XErrorHandler previous = XSetErrorHandler(ShmAttachErrorHandler);
+    bool attached = XShmAttach(aDisplay, aInfo);
+    // Errors arrive with the round trip. The server also has to be attached
+    // before the segment is marked for removal
+    XSync(aDisplay, False);
+    XSetErrorHandler(previous);
+    return attached && !sShmAttachFailed;
+}
+#endif
+
+struct ShmBackBufferX11
+{
+#if defined(Q_WS_X11)
+    ShmBackBufferX11() : mImage(NULL), mGC(0), mDrawable(0), mPendingPut(false) {}
+
+    XShmSegmentInfo mShmInfo;
+    XImage* mImage;
+    GC mGC;
+    Qt::HANDLE mDrawable;
+    bool mPendingPut;
+#endif
+};
+
+ShmBackBuffer::ShmBackBuffer()
+    : mShmId(-1)
+    , mData(NULL)
+    , mFormat(QImage::Format_Invalid)
+    , mBytesPerLine(0)
+    , mX11(NULL)
+{
+}
+
+ShmBackBuffer::~ShmBackBuffer()
+{
+    release();
+}
+
+QImage ShmBackBuffer::create(const QSize& aSize, QImage::Format aFormat)
+{
+    if (mData && mSize == aSize && mFormat == aFormat) {
+        return QImage(mData, mSize.width(), mSize.height(), mBytesPerLine, mFormat);
+    }
+    release();
+
+    int depth = aFormat == QImage::Format_RGB16 ? 16 : 32;
+    int bytesPerLine = ((aSize.width() * depth + 31) / 32) * 4;
+    mShmId = shmget(IPC_PRIVATE, bytesPerLine * aSize.height(), IPC_CREAT | 0600);
+    if (mShmId == -1) {
+        LOGT("shmget failed for %ix%i", aSize.width(), aSize.height());
+        return QImage();
+    }
+    void* data = shmat(mShmId, NULL, 0);
+    if (data == (void*)-1) {
+        LOGT("shmat failed");
+        shmctl(mShmId, IPC_RMID, NULL);
+        mShmId = -1;
+        return QImage();
+    }
+    mData = static_cast<uchar*>(data);
+    mSize = aSize;
+    mFormat = aFormat;
+    mBytesPerLine = bytesPerLine;
+
+#if defined(Q_WS_X11)
+    Display* dpy = QX11Info::display();
+    // Server side blending is not available, so only opaque formats matching
+    // the visual can be put directly
+    bool matchesVisual = (aFormat == QImage::Format_RGB16 && QX11Info::appDepth() == 16) ||
+                         (aFormat == QImage::Format_RGB32 && QX11Info::appDepth() == 24);
+    if (dpy && matchesVisual && XShmQueryExtension(dpy)) {
+        mX11 = new ShmBackBufferX11();
+        mX11->mShmInfo.shmid = mShmId;
+        mX11->mShmInfo.shmaddr = reinterpret_cast<char*>(mData);
+        mX11->mShmInfo.readOnly = True;
+        mX11->mImage = XShmCreateImage(dpy, static_cast<Visual*>(QX11Info::appVisual()),
+                                       QX11Info::appDepth(), ZPixmap,
+                                       mX11->mShmInfo.shmaddr, &mX11->mShmInfo,
+                                       aSize.width(), aSize.height());
+        if (!mX11->mImage || mX11->mImage->bytes_per_line != bytesPerLine ||
+            !AttachShm(dpy, &mX11->mShmInfo)) {
+            LOGT("XShm not usable for this visual, falling back to drawImage");
+            if (mX11->mImage) {
+                mX11->mImage->data = NULL;
+                XDestroyImage(mX11->mImage);
+            }
+            delete mX11;
+            mX11 = NULL;
+        }
+    }
+#endif
+    shmctl(mShmId, IPC_RMID, NULL);
+
+    LOGT("Created segment %i for %ix%i, bpl:%i", mShmId, aSize.width(), aSize.height(), bytesPerLine);
+    return QImage(mData, mSize.width(), mSize.height(), mBytesPerLine, mFormat);
+}
+
+void ShmBackBuffer::release()
+{
+    if (!mData) {
+        return;
+    }
+#if defined(Q_WS_X11)
+    if (mX11) {
+        Display* dpy = QX11Info::display();
+        XShmDetach(dpy, &mX11->mShmInfo);
+        if (mX11->mGC) {
+            XFreeGC(dpy, mX11->mGC);
+        }
+        mX11->mImage->data = NULL;
+        XDestroyImage(mX11->mImage);
+        XSync(dpy, False);
+        delete mX11;
+        mX11 = NULL;
+    }
+#endif
+    shmdt(mData);
+    mData = NULL;
+    mShmId = -1;
+    mSize = QSize();
+    mFormat = QImage::Format_Invalid;
+}
+
+void ShmBackBuffer::sync()
+{
+#if defined(Q_WS_X11)
+    if (mX11 && mX11->mPendingPut) {
+        XSync(QX11Info::display(), False);
+        mX11->mPendingPut = false;
+    }
+#endif
+}
+
+bool ShmBackBuffer::present(QPainter* aPainter, const QRect& aSource)
+{
+#if defined(Q_WS_X11)
+    QPaintEngine* engine = aPainter->paintEngine();
+    if (!mX11 || !engine || engine->type() != QPaintEngine::X11) {
+        return false;
+    }
+    // Only plain offsets can be done by the server, anything else goes through Qt
+    QTransform transform = aPainter->deviceTransform();
+    if (transform.type() > QTransform::TxTranslate) {
+        return false;
+    }
+
+    // Widgets, like the QGraphicsView viewport, are painted into the
+    // backing store pixmap of their window. The device transform includes
+    // the widget's offset in it, the system clip is the exposed area there
+    QPaintDevice* device = engine->paintDevice();
+    if (!device || device->devType() != QInternal::Pixmap) {
+        return false;
+    }
+    Qt::HANDLE drawable = static_cast<QPixmap*>(device)->handle();
+    if (!drawable || device->depth() != QX11Info::appDepth()) {
+        return false;
+    }
+
+    QRect source = aSource.intersected(QRect(QPoint(0, 0), mSize));
+    QPoint target = transform.map(source.topLeft());
+    QRegion clip(QRect(target, source.size()));
+    if (!engine->systemClip().isEmpty()) {
+        clip &= engine->systemClip();
+    }
+    if (aPainter->hasClipping()) {
+        clip &= transform.map(aPainter->clipRegion());
+    }
+    if (clip.isEmpty()) {
+        return true;
+    }
+
+    Display* dpy = QX11Info::display();
+    if (!mX11->mGC || mX11->mDrawable != drawable) {
+        if (mX11->mGC) {
+            XFreeGC(dpy, mX11->mGC);
+        }
+        mX11->mGC = XCreateGC(dpy, drawable, 0, NULL);
+        mX11->mDrawable = drawable;
+    }
+    QVector<QRect> rects = clip.rects();
+    QVarLengthArray<XRectangle, 32> xrects(rects.size());
+    for (int i = 0; i < rects.size(); ++i) {
+        xrects[i].x = rects.at(i).x();
+        xrects[i].y = rects.at(i).y();
+        xrects[i].width = rects.at(i).width();
+        xrects[i].height = rects.at(i).height();
+    }
+    XSetClipRectangles(dpy, mX11->mGC, 0, 0, xrects.data(), xrects.size(), Unsorted);
+
+    XShmPutImage(dpy, drawable, mX11->mGC, mX11->mImage,
+                 source.x(), source.y(), target.x(), target.y(),
+                 source.width(), source.height(), False);
+    mX11->mPendingPut = true;
+    return true;
+#else
+    return false;
+#endif
+}
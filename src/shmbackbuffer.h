@@ -0,0 +1,57 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef SHMBACKBUFFER_H
+#define SHMBACKBUFFER_H
+
+#include <QImage>
+
+class QPainter;
+struct ShmBackBufferX11;
+
+/*!
+ * Software back buffer living in a SysV shared memory segment.
+ *
+ * Gecko renders straight into the segment through the QImage returned by
+ * create(), and on X11 the same segment is attached to the server with MIT-SHM
+ * so present() can put it into the window's backing store without the copy
+ * drawImage makes. That needs Qt4's native X11 graphics system, with the
+ * raster graphics system or Qt5 present() always declines.
+ * The segment is marked for removal as soon as everybody attached to it, so
+ * it goes away with the process even if we crash.
+ */
+class ShmBackBuffer
+{
+public:
+    ShmBackBuffer();
+    ~ShmBackBuffer();
+
+    // Returns an image wrapping the segment without copying it, or a null
+    // image if shared memory is not available. Images returned earlier are
+    // invalid after next create() or release() call.
+    QImage create(const QSize& aSize, QImage::Format aFormat);
+    void release();
+    bool isValid() const { return mData != NULL; }
+
+    // Waits until the server is done reading the segment, must be called
+    // before rendering into it again
+    void sync();
+    // Puts aSource of the buffer where the painter would draw it, honouring
+    // its offset and clip. Returns false if the painter cannot take it (not
+    // an X11 pixmap or backing store, scaled or rotated) and drawImage
+    // should be used
+    bool present(QPainter* aPainter, const QRect& aSource);
+
+private:
+    int mShmId;
+    uchar* mData;
+    QSize mSize;
+    QImage::Format mFormat;
+    int mBytesPerLine;
+    ShmBackBufferX11* mX11;
+};
+
+#endif
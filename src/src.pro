@@ -7,13 +7,37 @@ SOURCES += qmozcontext.cpp \
            EmbedQtKeyUtils.cpp \
            qgraphicsmozview.cpp \
            qgraphicsmozview_p.cpp \
-           geckoworker.cpp
+           geckoworker.cpp \
+           geckothreadpolicy.cpp \
+           renderworker.cpp \
+           shmbackbuffer.cpp \
+           framescheduler.cpp \
+           viewpool.cpp \
+           prefsfile.cpp \
+           tiledbackingstore.cpp \
+           latencyhistogram.cpp \
+           qmozheadlessview.cpp \
+           qmozsnapshotqueue.cpp \
+           messagecodec.cpp \
+           shmattachment.cpp
 
 HEADERS += qmozcontext.h \
            EmbedQtKeyUtils.h \
            qgraphicsmozview.h \
            qgraphicsmozview_p.h \
-           geckoworker.h
+           geckoworker.h \
+           geckothreadpolicy.h \
+           renderworker.h \
+           shmbackbuffer.h \
+           framescheduler.h \
+           viewpool.h \
+           prefsfile.h \
+           tiledbackingstore.h \
+           latencyhistogram.h \
+           qmozheadlessview.h \
+           qmozsnapshotqueue.h \
+           messagecodec.h \
+           shmattachment.h
 
 !contains(QT_MAJOR_VERSION, 4) {
 SOURCES += quickmozview.cpp
@@ -45,10 +69,15 @@ PREFIX = /usr
 contains(QT_MAJOR_VERSION, 4) {
   QT += opengl
   PKGCONFIG += QJson
+  # MIT-SHM for the shared memory back buffer
+  x11:LIBS += -lXext
 } else {
   QT += quick opengl
 }
 
+# shm_open for message attachments
+unix:LIBS += -lrt
+
 target.path = $$PREFIX/lib
 
 QMAKE_PKGCONFIG_NAME = qtembedwidget
@@ -63,4 +92,7 @@ FORWARDING_HEADERS = $$system( find q*.h )
 
 forwarding_headers.path = $$PREFIX/include
 forwarding_headers.files = $$FORWARDING_HEADERS
-INSTALLS += forwarding_headers target
+# frame script side of the binary message encoding
+messagecodec_script.path = $$PREFIX/share/qtmozembed
+messagecodec_script.files = messagecodec.js
+INSTALLS += forwarding_headers messagecodec_script target
@@ -0,0 +1,200 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#define LOG_COMPONENT "TiledBackingStore"
+
+#include <QPainter>
+#include <string.h>
+
+#include "tiledbackingstore.h"
+#include "mozilla/embedlite/EmbedLog.h"
+
+static int floorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+TiledBackingStore::TiledBackingStore(const QSize& aTileSize)
+    : mTileSize(aTileSize)
+    , mMaxBytes(0)
+    , mBytes(0)
+    , mUseCounter(0)
+    , mHits(0)
+    , mMisses(0)
+{
+}
+
+void TiledBackingStore::setMaxBytes(int aBytes)
+{
+    mMaxBytes = qMax(0, aBytes);
+    if (!mMaxBytes) {
+        clear();
+    } else {
+        evict();
+    }
+}
+
+void TiledBackingStore::clear()
+{
+    mTiles.clear();
+    mBytes = 0;
+}
+
+QRect TiledBackingStore::tileRect(const TileKey& aKey) const
+{
+    return QRect(QPoint(aKey.first * mTileSize.width(), aKey.second * mTileSize.height()), mTileSize);
+}
+
+QList<TiledBackingStore::TileKey> TiledBackingStore::tilesFor(const QRect& aContentRect) const
+{
+    QList<TileKey> keys;
+    int left = floorDiv(aContentRect.left(), mTileSize.width());
+    int right = floorDiv(aContentRect.right(), mTileSize.width());
+    int top = floorDiv(aContentRect.top(), mTileSize.height());
+    int bottom = floorDiv(aContentRect.bottom(), mTileSize.height());
+    for (int y = top; y <= bottom; ++y) {
+        for (int x = left; x <= right; ++x) {
+            keys.append(TileKey(x, y));
+        }
+    }
+    return keys;
+}
+
+void TiledBackingStore::update(const QImage& aFrame, const QPoint& aContentOffset)
+{
+    if (!isEnabled() || aFrame.isNull()) {
+        return;
+    }
+    QRect frameRect(aContentOffset, aFrame.size());
+    mUseCounter++;
+    Q_FOREACH(const TileKey& key, tilesFor(frameRect)) {
+        QRect rect = tileRect(key);
+        QRect covered = rect.intersected(frameRect);
+        Tile& tile = mTiles[key];
+        if (tile.mImage.isNull() || tile.mImage.format() != aFrame.format()) {
+            if (!tile.mImage.isNull()) {
+                mBytes -= tile.mImage.byteCount();
+            }
+            tile.mImage = QImage(mTileSize, aFrame.format());
+            tile.mValid = QRegion();
+            mBytes += tile.mImage.byteCount();
+        }
+        QPainter p(&tile.mImage);
+        p.setCompositionMode(QPainter::CompositionMode_Source);
+        p.drawImage(covered.topLeft() - rect.topLeft(), aFrame,
+                    covered.translated(-aContentOffset));
+        tile.mValid += covered.translated(-rect.topLeft());
+        tile.mLastUse = mUseCounter;
+    }
+    evict();
+}
+
+bool TiledBackingStore::covers(const QRect& aContentRect)
+{
+    if (!isEnabled()) {
+        return false;
+    }
+    bool covered = true;
+    Q_FOREACH(const TileKey& key, tilesFor(aContentRect)) {
+        QRect needed = tileRect(key).intersected(aContentRect).translated(-tileRect(key).topLeft());
+        QHash<TileKey, Tile>::const_iterator it = mTiles.constFind(key);
+        if (it != mTiles.constEnd() && (QRegion(needed) - it->mValid).isEmpty()) {
+            mHits++;
+        } else {
+            mMisses++;
+            covered = false;
+        }
+    }
+    return covered;
+}
+
+void TiledBackingStore::paint(QImage& aTarget, const QPoint& aContentOffset, const QColor& aBgColor)
+{
+    QRect viewRect(aContentOffset, aTarget.size());
+    QRegion missing(aTarget.rect());
+    QPainter p(&aTarget);
+    p.setCompositionMode(QPainter::CompositionMode_Source);
+    mUseCounter++;
+    Q_FOREACH(const TileKey& key, tilesFor(viewRect)) {
+        QHash<TileKey, Tile>::iterator it = mTiles.find(key);
+        if (it == mTiles.end()) {
+            continue;
+        }
+        QRect rect = tileRect(key);
+        QRegion valid = it->mValid.translated(rect.topLeft() - aContentOffset) & aTarget.rect();
+        p.setClipRegion(valid);
+        p.drawImage(rect.topLeft() - aContentOffset, it->mImage);
+        missing -= valid;
+        it->mLastUse = mUseCounter;
+    }
+    if (!missing.isEmpty()) {
+        p.setClipRegion(missing);
+        p.fillRect(aTarget.rect(), aBgColor);
+    }
+}
+
+// matches() compares one pixel per kSampleStep x kSampleStep block, changed
+// content smaller than that can go unnoticed
+static const int kSampleStep = 8;
+
+static bool samePixel(const uchar* a, const uchar* b, const QImage& aFrame)
+{
+    if (aFrame.depth() == 32) {
+        quint32 diff = *reinterpret_cast<const quint32*>(a) ^ *reinterpret_cast<const quint32*>(b);
+        // Padding byte is undefined in RGB32
+        return !(aFrame.format() == QImage::Format_RGB32 ? diff & 0x00ffffff : diff);
+    }
+    return !memcmp(a, b, aFrame.depth() / 8);
+}
+
+bool TiledBackingStore::matches(const QImage& aFrame, const QPoint& aContentOffset) const
+{
+    QRect frameRect(aContentOffset, aFrame.size());
+    const int bytesPerPixel = aFrame.depth() / 8;
+    Q_FOREACH(const TileKey& key, tilesFor(frameRect)) {
+        QHash<TileKey, Tile>::const_iterator it = mTiles.constFind(key);
+        if (it == mTiles.constEnd()) {
+            continue;
+        }
+        if (it->mImage.format() != aFrame.format()) {
+            return false;
+        }
+        QRect rect = tileRect(key);
+        QRegion overlap = it->mValid & frameRect.translated(-rect.topLeft());
+        // Position of the tile origin inside aFrame
+        QPoint origin = rect.topLeft() - aContentOffset;
+        Q_FOREACH(const QRect& r, overlap.rects()) {
+            // Grid aligned to content, so frames at any offset sample alike
+            int top = r.top() + (kSampleStep - 1) - (r.top() + kSampleStep - 1) % kSampleStep;
+            int left = r.left() + (kSampleStep - 1) - (r.left() + kSampleStep - 1) % kSampleStep;
+            for (int y = top; y <= r.bottom(); y += kSampleStep) {
+                const uchar* cached = it->mImage.constScanLine(y);
+                const uchar* fresh = aFrame.constScanLine(origin.y() + y);
+                for (int x = left; x <= r.right(); x += kSampleStep) {
+                    if (!samePixel(cached + x * bytesPerPixel,
+                                   fresh + (origin.x() + x) * bytesPerPixel, aFrame)) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void TiledBackingStore::evict()
+{
+    while (mBytes > mMaxBytes && !mTiles.isEmpty()) {
+        QHash<TileKey, Tile>::iterator oldest = mTiles.begin();
+        for (QHash<TileKey, Tile>::iterator it = mTiles.begin(); it != mTiles.end(); ++it) {
+            if (it->mLastUse < oldest->mLastUse) {
+                oldest = it;
+            }
+        }
+        mBytes -= oldest->mImage.byteCount();
+        mTiles.erase(oldest);
+    }
+}
@@ -0,0 +1,73 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef TILEDBACKINGSTORE_H
+#define TILEDBACKINGSTORE_H
+
+#include <QHash>
+#include <QImage>
+#include <QPair>
+#include <QRegion>
+
+/*!
+ * Cache of rendered content split into fixed size tiles, addressed in
+ * content (page) pixels at the current resolution.
+ *
+ * Frames rendered by Gecko are chopped into tiles together with the scroll
+ * offset they were rendered at. After a scroll, a viewport fully covered by
+ * cached tiles can be composed without asking Gecko for a new frame.
+ * Memory is bounded; least recently used tiles are dropped first.
+ */
+class TiledBackingStore
+{
+public:
+    TiledBackingStore(const QSize& aTileSize = QSize(256, 256));
+
+    void setMaxBytes(int aBytes);
+    int maxBytes() const { return mMaxBytes; }
+    bool isEnabled() const { return mMaxBytes > 0; }
+
+    void clear();
+    // Stores aFrame, which shows content starting at aContentOffset
+    void update(const QImage& aFrame, const QPoint& aContentOffset);
+    // Checks whether every tile of aContentRect is cached, counting hits
+    // and misses per tile
+    bool covers(const QRect& aContentRect);
+    // Composes content at aContentOffset into aTarget, uncovered parts are
+    // filled with aBgColor
+    void paint(QImage& aTarget, const QPoint& aContentOffset, const QColor& aBgColor);
+    // Checks that aFrame, rendered at aContentOffset, agrees with the cached
+    // pixels it overlaps, sampled on an 8 pixel grid. Content that does not
+    // move with the scroll offset (position:fixed, animations) makes
+    // composed frames wrong.
+    bool matches(const QImage& aFrame, const QPoint& aContentOffset) const;
+
+    int hits() const { return mHits; }
+    int misses() const { return mMisses; }
+
+private:
+    typedef QPair<int, int> TileKey;
+    struct Tile {
+        QImage mImage;
+        // Part of the tile holding valid content, tile coordinates
+        QRegion mValid;
+        quint32 mLastUse;
+    };
+
+    QRect tileRect(const TileKey& aKey) const;
+    QList<TileKey> tilesFor(const QRect& aContentRect) const;
+    void evict();
+
+    QSize mTileSize;
+    int mMaxBytes;
+    int mBytes;
+    quint32 mUseCounter;
+    int mHits;
+    int mMisses;
+    QHash<TileKey, Tile> mTiles;
+};
+
+#endif
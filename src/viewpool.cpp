@@ -0,0 +1,191 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#define LOG_COMPONENT "ViewPool"
+
+#include <stdlib.h>
+
+#include "viewpool.h"
+#include "mozilla/embedlite/EmbedLog.h"
+#include "mozilla/embedlite/EmbedLiteApp.h"
+#include "mozilla/embedlite/EmbedLiteView.h"
+
+using namespace mozilla::embedlite;
+
+// Every pooled view is a content window, keep the memory bounded
+static const int kMaxViewPoolSize = 4;
+// Refill only after views stopped being taken for this long
+static const int kRefillDelay = 1000;
+
+class ViewPoolEntry : public EmbedLiteViewListener
+{
+public:
+    ViewPoolEntry(ViewPool* aPool)
+        : mPool(aPool)
+        , mView(NULL)
+        , mInitialized(false)
+    {
+    }
+
+    virtual void ViewInitialized() {
+        mInitialized = true;
+        mPool->viewInitialized(this);
+    }
+    virtual void ViewDestroyed() {
+        mView = NULL;
+        mPool->viewDestroyed(this);
+    }
+
+    ViewPool* mPool;
+    EmbedLiteView* mView;
+    bool mInitialized;
+};
+
+ViewPool::ViewPool(QObject* parent)
+    : QObject(parent)
+    , mApp(NULL)
+    , mCapacity(0)
+    , mHits(0)
+    , mMisses(0)
+{
+    mRefillTimer.setSingleShot(true);
+    mRefillTimer.setInterval(kRefillDelay);
+    connect(&mRefillTimer, SIGNAL(timeout()), this, SLOT(refill()));
+    if (getenv("MOZ_VIEW_POOL_SIZE")) {
+        setCapacity(atoi(getenv("MOZ_VIEW_POOL_SIZE")));
+    }
+}
+
+ViewPool::~ViewPool()
+{
+    stop();
+}
+
+void ViewPool::start(EmbedLiteApp* aApp)
+{
+    mApp = aApp;
+    scheduleRefill();
+}
+
+void ViewPool::stop()
+{
+    mRefillTimer.stop();
+    while (!mEntries.isEmpty()) {
+        destroyEntry(mEntries.takeLast());
+    }
+    mApp = NULL;
+}
+
+void ViewPool::setCapacity(int aCapacity)
+{
+    mCapacity = qBound(0, aCapacity, kMaxViewPoolSize);
+    LOGT("capacity:%i", mCapacity);
+    while (mEntries.size() > mCapacity) {
+        destroyEntry(mEntries.takeLast());
+    }
+    scheduleRefill();
+}
+
+int ViewPool::capacity() const
+{
+    return mCapacity;
+}
+
+EmbedLiteView* ViewPool::take(bool* aInitialized)
+{
+    if (mEntries.isEmpty()) {
+        if (mCapacity > 0) {
+            mMisses++;
+        }
+        return NULL;
+    }
+
+    // Ready views first, a pending one still saves part of the setup
+    ViewPoolEntry* entry = mEntries.first();
+    Q_FOREACH(ViewPoolEntry* candidate, mEntries) {
+        if (candidate->mInitialized) {
+            entry = candidate;
+            break;
+        }
+    }
+    mEntries.removeOne(entry);
+
+    EmbedLiteView* view = entry->mView;
+    view->SetListener(NULL);
+    *aInitialized = entry->mInitialized;
+    delete entry;
+    mHits++;
+    scheduleRefill();
+    return view;
+}
+
+QVariantMap ViewPool::statistics() const
+{
+    int ready = 0;
+    Q_FOREACH(ViewPoolEntry* entry, mEntries) {
+        if (entry->mInitialized) {
+            ready++;
+        }
+    }
+    QVariantMap stats;
+    stats.insert("capacity", mCapacity);
+    stats.insert("ready", ready);
+    stats.insert("pending", mEntries.size() - ready);
+    stats.insert("hits", mHits);
+    stats.insert("misses", mMisses);
+    return stats;
+}
+
+void ViewPool::refill()
+{
+    if (!mApp || mEntries.size() >= mCapacity) {
+        return;
+    }
+    // One view at a time, the next is created once this one is up
+    Q_FOREACH(ViewPoolEntry* entry, mEntries) {
+        if (!entry->mInitialized) {
+            return;
+        }
+    }
+    ViewPoolEntry* entry = new ViewPoolEntry(this);
+    entry->mView = mApp->CreateView();
+    entry->mView->SetListener(entry);
+    mEntries.append(entry);
+    LOGT("pooled view:%u, pool size:%i", entry->mView->GetUniqueID(), mEntries.size());
+}
+
+void ViewPool::viewInitialized(ViewPoolEntry* aEntry)
+{
+    Q_UNUSED(aEntry);
+    scheduleRefill();
+}
+
+void ViewPool::viewDestroyed(ViewPoolEntry* aEntry)
+{
+    // Gecko tore the view down by itself
+    mEntries.removeOne(aEntry);
+    delete aEntry;
+    scheduleRefill();
+}
+
+void ViewPool::destroyEntry(ViewPoolEntry* aEntry)
+{
+    if (aEntry->mView) {
+        aEntry->mView->SetListener(NULL);
+        if (mApp) {
+            mApp->DestroyView(aEntry->mView);
+        }
+    }
+    delete aEntry;
+}
+
+void ViewPool::scheduleRefill()
+{
+    if (mApp && mEntries.size() < mCapacity) {
+        // Restarting keeps refills out of the way while views are opened
+        mRefillTimer.start();
+    }
+}
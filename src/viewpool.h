@@ -0,0 +1,68 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef VIEWPOOL_H
+#define VIEWPOOL_H
+
+#include <QObject>
+#include <QList>
+#include <QTimer>
+#include <QVariantMap>
+
+namespace mozilla {
+namespace embedlite {
+class EmbedLiteApp;
+class EmbedLiteView;
+}}
+
+class ViewPoolEntry;
+
+/*!
+ * Keeps a few parentless EmbedLiteViews created and initialized ahead of
+ * time, so new views don't wait for Gecko to set one up. The pool refills
+ * one view at a time once no view has been taken for a while.
+ */
+class ViewPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ViewPool(QObject* parent = 0);
+    virtual ~ViewPool();
+
+    // Views are created only between start and stop
+    void start(mozilla::embedlite::EmbedLiteApp* aApp);
+    void stop();
+
+    // Capped at kMaxViewPoolSize, 0 disables the pool
+    void setCapacity(int aCapacity);
+    int capacity() const;
+
+    // Returns a view without listener, or NULL when the pool is empty.
+    // aInitialized tells whether ViewInitialized was already delivered
+    mozilla::embedlite::EmbedLiteView* take(bool* aInitialized);
+
+    QVariantMap statistics() const;
+
+private Q_SLOTS:
+    void refill();
+
+private:
+    friend class ViewPoolEntry;
+    void viewInitialized(ViewPoolEntry* aEntry);
+    void viewDestroyed(ViewPoolEntry* aEntry);
+    void destroyEntry(ViewPoolEntry* aEntry);
+    void scheduleRefill();
+
+    mozilla::embedlite::EmbedLiteApp* mApp;
+    QList<ViewPoolEntry*> mEntries;
+    QTimer mRefillTimer;
+    int mCapacity;
+    int mHits;
+    int mMisses;
+};
+
+#endif
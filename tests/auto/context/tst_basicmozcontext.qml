@@ -77,5 +77,66 @@ ApplicationWindow {
             compare(lastObserveMessage.data.msg, "testMessage");
             mozContext.dumpTS("test_context4ObserveAPI end")
         }
+        function test_context5FrameSchedulerAPI()
+        {
+            mozContext.dumpTS("test_context5FrameSchedulerAPI start")
+            mozContext.instance.setTargetFrameRate(30);
+            compare(mozContext.instance.targetFrameRate(), 30);
+            var stats = mozContext.instance.frameStatistics();
+            verify(stats.coalesced !== undefined)
+            verify(stats.dropped !== undefined)
+            mozContext.instance.setTargetFrameRate(60);
+            mozContext.dumpTS("test_context5FrameSchedulerAPI end")
+        }
+        function test_context6ObserverRefcount()
+        {
+            mozContext.dumpTS("test_context6ObserverRefcount start")
+            // test_context4ObserveAPI holds one subscription already
+            mozContext.instance.addObserver("test-observe-message");
+            mozContext.instance.removeObserver("test-observe-message");
+            lastObserveMessage = undefined
+            mozContext.instance.sendObserve("test-observe-message", {msg: "stillObserved", val: 2});
+            while (lastObserveMessage === undefined) {
+                mozContext.waitLoop()
+            }
+            compare(lastObserveMessage.data.msg, "stillObserved");
+
+            mozContext.instance.removeObserver("test-observe-message");
+            lastObserveMessage = undefined
+            mozContext.instance.sendObserve("test-observe-message", {msg: "unobserved", val: 3});
+            wait(500)
+            verify(lastObserveMessage === undefined)
+            mozContext.dumpTS("test_context6ObserverRefcount end")
+        }
+        function test_context7StartupTimeline()
+        {
+            mozContext.dumpTS("test_context7StartupTimeline start")
+            var timeline = mozContext.instance.startupTimeline();
+            var phases = timeline.map(function(mark) { return mark.phase; });
+            verify(phases.indexOf("context-created") === 0)
+            verify(phases.indexOf("initialized") > phases.indexOf("app-created"))
+            for (var i = 1; i < timeline.length; ++i) {
+                verify(timeline[i].time >= timeline[i - 1].time)
+            }
+            mozContext.instance.markStartupPhase("test-phase");
+            mozContext.instance.markStartupPhase("test-phase");
+            timeline = mozContext.instance.startupTimeline();
+            compare(timeline[timeline.length - 1].phase, "test-phase");
+            compare(timeline[timeline.length - 2].phase === "test-phase", false);
+            mozContext.dumpTS("test_context7StartupTimeline end")
+        }
+        function test_context8BulkPrefs()
+        {
+            mozContext.dumpTS("test_context8BulkPrefs start")
+            var prefs = {"embedlite.test.string": "value", "embedlite.test.int": 5, "embedlite.test.bool": true};
+            mozContext.instance.setPrefs(prefs);
+            var skipped = mozContext.instance.prefStatistics().skipped;
+            mozContext.instance.setPrefs(prefs);
+            compare(mozContext.instance.prefStatistics().skipped, skipped + 3);
+            mozContext.instance.setPref("embedlite.test.int", 6);
+            compare(mozContext.instance.prefStatistics().skipped, skipped + 3);
+            compare(mozContext.instance.loadPrefsFile("/nonexistent/prefs.js"), -1);
+            mozContext.dumpTS("test_context8BulkPrefs end")
+        }
     }
 }
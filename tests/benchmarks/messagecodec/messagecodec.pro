@@ -0,0 +1,18 @@
+TEMPLATE = app
+TARGET = tst_messagecodec
+CONFIG += warn_on
+QT += testlib
+INCLUDEPATH += ../../../src
+SOURCES += tst_messagecodec.cpp \
+           ../../../src/messagecodec.cpp
+HEADERS += ../../../src/messagecodec.h
+
+contains(QT_MAJOR_VERSION, 4) {
+  CONFIG += link_pkgconfig
+  PKGCONFIG += QJson
+}
+
+target.path = /opt/tests/qtmozembed/benchmarks
+script.files = messagecodec_bench.js
+script.path = /opt/tests/qtmozembed/benchmarks
+INSTALLS += target script
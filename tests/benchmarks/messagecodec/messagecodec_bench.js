@@ -0,0 +1,47 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * Content side cost of CBOR message data: MessageCodec.decode() against
+ * JSON.parse() of the same payload. Run with
+ *   xpcshell -f /usr/share/qtmozembed/messagecodec.js messagecodec_bench.js
+ */
+"use strict";
+
+const kRuns = 200;
+
+function payload(aSamples, aText) {
+    let samples = [];
+    for (let i = 0; i < aSamples; i++) {
+        samples.push({ timestamp: 1380000000 + i, duration: i * 0.25,
+                       name: "frame-" + i, painted: i % 2 == 0 });
+    }
+    return { topic: "telemetry:frames", samples: samples, text: aText };
+}
+
+function perRun(aFunction) {
+    let start = Date.now();
+    for (let i = 0; i < kRuns; i++)
+        aFunction();
+    return (Date.now() - start) / kRuns;
+}
+
+let cases = [
+    ["small", payload(10, "")],
+    ["samples", payload(1000, "")],
+    ["ascii-text", payload(10, new Array(12001).join("x"))],
+    ["utf8-text", payload(10, new Array(2001).join("héllo "))]
+];
+
+for (let i = 0; i < cases.length; i++) {
+    let cbor = MessageCodec.encode(cases[i][1]);
+    let json = JSON.stringify(cases[i][1]);
+    if (JSON.stringify(MessageCodec.decode(cbor)) != json)
+        throw new Error(cases[i][0] + ": decoded payload differs");
+    let cborTime = perRun(function() { MessageCodec.decode(cbor); });
+    let jsonTime = perRun(function() { JSON.parse(json); });
+    print(cases[i][0] + ": cbor " + cborTime.toFixed(3) + " ms (" + cbor.length +
+          " chars), json " + jsonTime.toFixed(3) + " ms (" + json.length + " chars)");
+}
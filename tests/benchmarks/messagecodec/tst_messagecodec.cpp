@@ -0,0 +1,250 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Compares the old JSON message path of QGraphicsMozView (QVariant -> JSON ->
+// UTF-8 -> UTF-16 and back) with the streaming UTF-16 JSON writer and the
+// opt-in CBOR encoding. Content side decoding cost is measured separately by
+// messagecodec_bench.js.
+
+#include <QtTest/QtTest>
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+#include <qjson/serializer.h>
+#include <qjson/parser.h>
+#else
+#include <QJsonDocument>
+#endif
+
+#include "messagecodec.h"
+
+class tst_MessageCodec : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void roundTrip();
+    void largeNegative();
+    void malformedCbor_data();
+    void malformedCbor();
+    void writeJson();
+    void encode_data();
+    void encode();
+    void decode_data();
+    void decode();
+
+private:
+    void addPayloads();
+};
+
+static QVariant TelemetryPayload(int aSamples)
+{
+    QVariantList samples;
+    for (int i = 0; i < aSamples; ++i) {
+        QVariantMap sample;
+        sample.insert("timestamp", 1380000000 + i);
+        sample.insert("duration", i * 0.25);
+        sample.insert("name", QString("frame-%1").arg(i));
+        sample.insert("painted", i % 2 == 0);
+        samples.append(sample);
+    }
+    QVariantMap payload;
+    payload.insert("topic", QString("telemetry:frames"));
+    payload.insert("samples", samples);
+    return payload;
+}
+
+static QString EncodeJson(const QVariant& aVariant)
+{
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+    QJson::Serializer serializer;
+    QByteArray array = serializer.serialize(aVariant);
+#else
+    QByteArray array = QJsonDocument::fromVariant(aVariant).toJson();
+#endif
+    return QString::fromUtf8(array.constData());
+}
+
+static QVariant DecodeJson(const QString& aData)
+{
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+    QJson::Parser parser;
+    return parser.parse(aData.toUtf8());
+#else
+    return QJsonDocument::fromJson(aData.toUtf8()).toVariant();
+#endif
+}
+
+void tst_MessageCodec::roundTrip()
+{
+    QVariantMap map;
+    map.insert("int", 42);
+    map.insert("negative", -100000);
+    map.insert("large", Q_INT64_C(8589934592));
+    map.insert("double", 1.5);
+    map.insert("bool", true);
+    map.insert("string", QString::fromUtf8("h\xc3\xa9llo"));
+    map.insert("list", QVariantList() << 1 << QString("two") << QVariant());
+    map.insert("bytes", QByteArray("\x00\x01\x02", 3));
+
+    bool ok = false;
+    QString payload = MessageCodec::EncodeBinaryPayload(map);
+    QVariant decoded = MessageCodec::DecodeBinaryPayload(payload.constData(), payload.size(), &ok);
+    QVERIFY(ok);
+    QCOMPARE(decoded.toMap(), map);
+
+    MessageCodec::DecodeCbor(QByteArray("\x82\x01", 2), &ok);
+    QVERIFY(!ok);
+}
+
+void tst_MessageCodec::largeNegative()
+{
+    bool ok = false;
+    QVariant value = MessageCodec::DecodeCbor(QByteArray("\x3b\x7f\xff\xff\xff\xff\xff\xff\xff", 9), &ok);
+    QVERIFY(ok);
+    QCOMPARE(value.type(), QVariant::LongLong);
+    QCOMPARE(value.toLongLong(), Q_INT64_C(-9223372036854775807) - 1);
+
+    // -2^64 doesn't fit a qint64
+    value = MessageCodec::DecodeCbor(QByteArray("\x3b\xff\xff\xff\xff\xff\xff\xff\xff", 9), &ok);
+    QVERIFY(ok);
+    QCOMPARE(value.type(), QVariant::Double);
+    QCOMPARE(value.toDouble(), -18446744073709551616.0);
+}
+
+void tst_MessageCodec::malformedCbor_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("truncated-array") << QByteArray("\x82\x01", 2);
+    QTest::newRow("truncated-uint") << QByteArray("\x19\x01", 2);
+    QTest::newRow("truncated-text") << QByteArray("\x65" "ab", 3);
+    QTest::newRow("indefinite-array-no-break") << QByteArray("\x9f\x01\x02", 3);
+    QTest::newRow("indefinite-array-empty") << QByteArray("\x9f", 1);
+    QTest::newRow("indefinite-map-no-break") << QByteArray("\xbf\x61" "a\x01", 4);
+    QTest::newRow("indefinite-map-no-value") << QByteArray("\xbf\x61" "a", 3);
+    QTest::newRow("indefinite-text-no-break") << QByteArray("\x7f\x61" "a", 3);
+    QTest::newRow("indefinite-bytes-no-break") << QByteArray("\x5f\x41\x00", 3);
+    QTest::newRow("nested-indefinite-no-break") << QByteArray("\x9f\x9f\xff", 3);
+    QTest::newRow("stray-break") << QByteArray("\xff", 1);
+    QTest::newRow("trailing-data") << QByteArray("\x01\x02", 2);
+    QTest::newRow("reserved-length") << QByteArray("\x1c", 1);
+    QTest::newRow("too-deep") << QByteArray(200, '\x81') + QByteArray("\x01", 1);
+}
+
+void tst_MessageCodec::malformedCbor()
+{
+    QFETCH(QByteArray, data);
+
+    bool ok = true;
+    MessageCodec::DecodeCbor(data, &ok);
+    QVERIFY(!ok);
+
+    // A well formed indefinite length payload still decodes
+    MessageCodec::DecodeCbor(QByteArray("\x9f\x01\xbf\x61" "a\x02\xff\xff", 8), &ok);
+    QVERIFY(ok);
+}
+
+void tst_MessageCodec::writeJson()
+{
+    QVariantMap map;
+    map.insert("text", QString("a\"b\\c\n\x01"));
+    map.insert("list", QVariantList() << 1 << 0.1 << true << QVariant());
+    map.insert("large", Q_INT64_C(8589934592));
+
+    QString json;
+    MessageCodec::WriteJson(map, json);
+    QCOMPARE(json, QString("{\"large\":8589934592,\"list\":[1,0.1,true,null],\"text\":\"a\\\"b\\\\c\\n\\u0001\"}"));
+
+    bool ok = false;
+    QVariant parsed = MessageCodec::DecodeJson(json.constData(), json.size(), &ok);
+    QVERIFY(ok);
+    QCOMPARE(parsed.toMap().value("text").toString(), map.value("text").toString());
+}
+
+enum Codec {
+    JsonDocument,
+    JsonWriter,
+    Cbor
+};
+
+Q_DECLARE_METATYPE(Codec)
+
+static QString Encode(Codec aCodec, const QVariant& aVariant)
+{
+    switch (aCodec) {
+    case JsonWriter: {
+        QString out;
+        MessageCodec::WriteJson(aVariant, out);
+        return out;
+    }
+    case Cbor:
+        return MessageCodec::EncodeBinaryPayload(aVariant);
+    default:
+        return EncodeJson(aVariant);
+    }
+}
+
+void tst_MessageCodec::addPayloads()
+{
+    QTest::addColumn<Codec>("codec");
+    QTest::addColumn<int>("samples");
+
+    QTest::newRow("json-small") << JsonDocument << 1;
+    QTest::newRow("writer-small") << JsonWriter << 1;
+    QTest::newRow("cbor-small") << Cbor << 1;
+    QTest::newRow("json-large") << JsonDocument << 200;
+    QTest::newRow("writer-large") << JsonWriter << 200;
+    QTest::newRow("cbor-large") << Cbor << 200;
+}
+
+void tst_MessageCodec::encode_data()
+{
+    addPayloads();
+}
+
+void tst_MessageCodec::encode()
+{
+    QFETCH(Codec, codec);
+    QFETCH(int, samples);
+
+    QVariant payload = TelemetryPayload(samples);
+    if (codec == JsonWriter) {
+        // As used by the view, appending to a reused buffer
+        QString buffer;
+        QBENCHMARK {
+            buffer.resize(0);
+            MessageCodec::WriteJson(payload, buffer);
+        }
+        return;
+    }
+    QBENCHMARK {
+        QString data = Encode(codec, payload);
+        Q_UNUSED(data);
+    }
+}
+
+void tst_MessageCodec::decode_data()
+{
+    addPayloads();
+}
+
+void tst_MessageCodec::decode()
+{
+    QFETCH(Codec, codec);
+    QFETCH(int, samples);
+
+    QVariant payload = TelemetryPayload(samples);
+    QString data = Encode(codec, payload);
+    QBENCHMARK {
+        QVariant result = codec == Cbor ? MessageCodec::DecodeBinaryPayload(data.constData(), data.size())
+                                        : DecodeJson(data);
+        Q_UNUSED(result);
+    }
+}
+
+QTEST_MAIN(tst_MessageCodec)
+
+#include "tst_messagecodec.moc"
@@ -0,0 +1,46 @@
+TEMPLATE = app
+TARGET = tst_messaging
+CONFIG += warn_on
+QT += testlib opengl
+
+# Library sources are built against the stand-in Gecko headers in tests/stubs
+SRC_DIR = ../../../src
+STUBS_DIR = ../../stubs
+INCLUDEPATH += $$STUBS_DIR $$SRC_DIR
+DEFINES += BUILD_GRE_HOME=\"\\\"/tmp\\\"\"
+unix:QMAKE_CXXFLAGS += -std=c++0x
+unix:LIBS += -lrt
+
+SOURCES += tst_messaging.cpp \
+           $$STUBS_DIR/stubs.cpp \
+           $$SRC_DIR/qmozcontext.cpp \
+           $$SRC_DIR/qgraphicsmozview.cpp \
+           $$SRC_DIR/qgraphicsmozview_p.cpp \
+           $$SRC_DIR/geckoworker.cpp \
+           $$SRC_DIR/geckothreadpolicy.cpp \
+           $$SRC_DIR/renderworker.cpp \
+           $$SRC_DIR/shmbackbuffer.cpp \
+           $$SRC_DIR/framescheduler.cpp \
+           $$SRC_DIR/viewpool.cpp \
+           $$SRC_DIR/prefsfile.cpp \
+           $$SRC_DIR/tiledbackingstore.cpp \
+           $$SRC_DIR/latencyhistogram.cpp \
+           $$SRC_DIR/messagecodec.cpp \
+           $$SRC_DIR/shmattachment.cpp
+
+HEADERS += $$SRC_DIR/qmozcontext.h \
+           $$SRC_DIR/qgraphicsmozview.h \
+           $$SRC_DIR/geckoworker.h \
+           $$SRC_DIR/geckothreadpolicy.h \
+           $$SRC_DIR/renderworker.h \
+           $$SRC_DIR/framescheduler.h \
+           $$SRC_DIR/viewpool.h
+
+contains(QT_MAJOR_VERSION, 4) {
+  CONFIG += link_pkgconfig
+  PKGCONFIG += QJson
+  x11:LIBS += -lXext
+}
+
+target.path = /opt/tests/qtmozembed/benchmarks
+INSTALLS += target
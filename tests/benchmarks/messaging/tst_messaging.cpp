@@ -0,0 +1,367 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Throughput of the messaging bridge between QML and Gecko: sendAsyncMessage,
+// RecvAsyncMessage, RecvSyncMessage, sendObserve and OnObserve. Gecko is
+// replaced by the recording EmbedLiteApp/EmbedLiteView in tests/stubs, so only
+// the cost on our side is measured. Besides the QBENCHMARK result every
+// case prints messages per second and heap allocations per message.
+
+#include <QtTest/QtTest>
+#include <QElapsedTimer>
+#include <new>
+#include <stdlib.h>
+
+#include "qgraphicsmozview.h"
+#include "qmozcontext.h"
+#include "messagecodec.h"
+#include "mozilla/embedlite/EmbedLiteApp.h"
+#include "mozilla/embedlite/EmbedInitGlue.h"
+
+using namespace mozilla::embedlite;
+
+static volatile long sAllocations = 0;
+
+void* operator new(size_t aSize)
+{
+    __sync_fetch_and_add(&sAllocations, 1);
+    void* p = malloc(aSize ? aSize : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t aSize)
+{
+    return operator new(aSize);
+}
+
+void operator delete(void* aPtr) throw()
+{
+    free(aPtr);
+}
+
+void operator delete[](void* aPtr) throw()
+{
+    free(aPtr);
+}
+
+static const int kMessages = 2000;
+
+// Counts time and allocations over kMessages deliveries
+class Throughput
+{
+public:
+    Throughput() : mAllocations(sAllocations) { mTimer.start(); }
+
+    double allocations() const { return double(sAllocations - mAllocations) / kMessages; }
+
+    void report(const char* aPath) const {
+        double seconds = mTimer.nsecsElapsed() / 1e9;
+        qDebug("%s/%s: %.0f msgs/s, %.1f allocs/msg", aPath, QTest::currentDataTag(),
+               kMessages / seconds, allocations());
+    }
+
+private:
+    QElapsedTimer mTimer;
+    long mAllocations;
+};
+
+class tst_Messaging : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_Messaging() : mContext(0), mView(0), mGeckoView(0), mReceived(0) {}
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void sendAsyncMessage_data();
+    void sendAsyncMessage();
+    void recvAsyncMessage_data();
+    void recvAsyncMessage();
+    void recvSyncMessage_data();
+    void recvSyncMessage();
+    void sendObserve_data();
+    void sendObserve();
+    void onObserve_data();
+    void onObserve();
+    void sendBlob_data();
+    void sendBlob();
+    void jsonBuffer_data();
+    void jsonBuffer();
+
+    void onMessage(const QString message, const QVariant data);
+    void onSyncMessage(const QString message, const QVariant data, QSyncMessageResponse* response);
+
+private:
+    void addPayloads();
+    EmbedLiteApp* app() const { return XRE_GetEmbedLite(); }
+
+    QMozContext* mContext;
+    QGraphicsMozView* mView;
+    EmbedLiteView* mGeckoView;
+    int mReceived;
+};
+
+void tst_Messaging::initTestCase()
+{
+    mContext = QMozContext::GetInstance();
+    app()->GetListener()->Initialized();
+    QVERIFY(mContext->initialized());
+
+    mView = new QGraphicsMozView();
+    QCoreApplication::processEvents();
+    mGeckoView = app()->mLastView;
+    QVERIFY(mGeckoView);
+    mGeckoView->GetListener()->ViewInitialized();
+
+    connect(mView, SIGNAL(recvAsyncMessage(QString, QVariant)),
+            this, SLOT(onMessage(QString, QVariant)));
+    connect(mView, SIGNAL(recvSyncMessage(QString, QVariant, QSyncMessageResponse*)),
+            this, SLOT(onSyncMessage(QString, QVariant, QSyncMessageResponse*)));
+    connect(mContext, SIGNAL(recvObserve(QString, QVariant)),
+            this, SLOT(onMessage(QString, QVariant)));
+    mContext->addObserver("bench:observe");
+}
+
+void tst_Messaging::cleanupTestCase()
+{
+    delete mView;
+}
+
+void tst_Messaging::onMessage(const QString message, const QVariant data)
+{
+    Q_UNUSED(message);
+    Q_UNUSED(data);
+    mReceived++;
+}
+
+void tst_Messaging::onSyncMessage(const QString message, const QVariant data, QSyncMessageResponse* response)
+{
+    Q_UNUSED(message);
+    mReceived++;
+    response->setMessage(data);
+}
+
+void tst_Messaging::addPayloads()
+{
+    QTest::addColumn<QVariant>("payload");
+
+    QVariantMap small;
+    small.insert("x", 10);
+    small.insert("y", 20);
+    QTest::newRow("small") << QVariant(small);
+
+    QVariantMap flat;
+    for (int i = 0; i < 64; ++i) {
+        flat.insert(QString("field%1").arg(i), i % 3 ? QVariant(i * 1.5) : QVariant(QString("value %1").arg(i)));
+    }
+    QTest::newRow("flat-map") << QVariant(flat);
+
+    QVariant deep = QVariantList() << 1 << 2 << 3;
+    for (int i = 0; i < 32; ++i) {
+        deep = QVariantList() << deep << QString("level %1").arg(i) << i;
+    }
+    QTest::newRow("deep-list") << deep;
+
+    QVariantMap text;
+    text.insert("text", QString(64 * 1024, QChar('x')));
+    QTest::newRow("long-string") << QVariant(text);
+}
+
+void tst_Messaging::sendAsyncMessage_data()
+{
+    addPayloads();
+}
+
+void tst_Messaging::sendAsyncMessage()
+{
+    QFETCH(QVariant, payload);
+
+    QBENCHMARK {
+        mView->sendAsyncMessage("bench:message", payload);
+    }
+
+    quint64 sent = mGeckoView->mSentMessages;
+    Throughput throughput;
+    for (int i = 0; i < kMessages; ++i) {
+        mView->sendAsyncMessage("bench:message", payload);
+    }
+    throughput.report("sendAsyncMessage");
+    QCOMPARE(mGeckoView->mSentMessages - sent, quint64(kMessages));
+}
+
+void tst_Messaging::recvAsyncMessage_data()
+{
+    addPayloads();
+}
+
+void tst_Messaging::recvAsyncMessage()
+{
+    QFETCH(QVariant, payload);
+
+    QString name("bench:message");
+    QString data;
+    MessageCodec::WriteJson(payload, data);
+    EmbedLiteViewListener* listener = mGeckoView->GetListener();
+
+    QBENCHMARK {
+        listener->RecvAsyncMessage(name.utf16(), data.utf16());
+    }
+
+    mReceived = 0;
+    Throughput throughput;
+    for (int i = 0; i < kMessages; ++i) {
+        listener->RecvAsyncMessage(name.utf16(), data.utf16());
+    }
+    throughput.report("RecvAsyncMessage");
+    QCOMPARE(mReceived, kMessages);
+}
+
+void tst_Messaging::recvSyncMessage_data()
+{
+    addPayloads();
+}
+
+void tst_Messaging::recvSyncMessage()
+{
+    QFETCH(QVariant, payload);
+
+    QString name("bench:sync");
+    QString data;
+    MessageCodec::WriteJson(payload, data);
+    EmbedLiteViewListener* listener = mGeckoView->GetListener();
+
+    QBENCHMARK {
+        free(listener->RecvSyncMessage(name.utf16(), data.utf16()));
+    }
+
+    mReceived = 0;
+    Throughput throughput;
+    for (int i = 0; i < kMessages; ++i) {
+        free(listener->RecvSyncMessage(name.utf16(), data.utf16()));
+    }
+    throughput.report("RecvSyncMessage");
+    QCOMPARE(mReceived, kMessages);
+    // Responses are released with deleteLater
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+}
+
+void tst_Messaging::sendObserve_data()
+{
+    addPayloads();
+}
+
+void tst_Messaging::sendObserve()
+{
+    QFETCH(QVariant, payload);
+
+    QBENCHMARK {
+        mContext->sendObserve("bench:observe", payload);
+    }
+
+    quint64 sent = app()->mObserves;
+    Throughput throughput;
+    for (int i = 0; i < kMessages; ++i) {
+        mContext->sendObserve("bench:observe", payload);
+    }
+    throughput.report("sendObserve");
+    QCOMPARE(app()->mObserves - sent, quint64(kMessages));
+}
+
+void tst_Messaging::onObserve_data()
+{
+    addPayloads();
+}
+
+void tst_Messaging::onObserve()
+{
+    QFETCH(QVariant, payload);
+
+    QString data;
+    MessageCodec::WriteJson(payload, data);
+    EmbedLiteAppListener* listener = app()->GetListener();
+
+    QBENCHMARK {
+        listener->OnObserve("bench:observe", data.utf16());
+    }
+
+    mReceived = 0;
+    Throughput throughput;
+    for (int i = 0; i < kMessages; ++i) {
+        listener->OnObserve("bench:observe", data.utf16());
+    }
+    throughput.report("OnObserve");
+    QCOMPARE(mReceived, kMessages);
+}
+
+void tst_Messaging::sendBlob_data()
+{
+    QTest::addColumn<bool>("attachment");
+
+    QTest::newRow("base64") << false;
+    QTest::newRow("shm") << true;
+}
+
+// A megabyte of binary data, as JSON text or as shared memory attachment
+void tst_Messaging::sendBlob()
+{
+    QFETCH(bool, attachment);
+
+    QByteArray blob(1024 * 1024, 'x');
+    QBENCHMARK {
+        if (attachment) {
+            QVariant descriptor = mView->createAttachment(blob);
+            QVERIFY(descriptor.isValid());
+            mView->sendAsyncMessage("bench:blob", descriptor);
+            // Both sides let go, as frame script and sender would
+            mView->releaseAttachment(descriptor);
+            QString release;
+            MessageCodec::WriteJson(descriptor, release);
+            mGeckoView->GetListener()->RecvAsyncMessage(QString("embed:attachment-release").utf16(),
+                                                        release.utf16());
+        } else {
+            mView->sendAsyncMessage("bench:blob", QString::fromLatin1(blob.toBase64()));
+        }
+    }
+}
+
+void tst_Messaging::jsonBuffer_data()
+{
+    addPayloads();
+}
+
+// What sendAsyncMessage and sendObserve save by serializing into a reserved
+// buffer instead of a new string per message
+void tst_Messaging::jsonBuffer()
+{
+    QFETCH(QVariant, payload);
+
+    Throughput fresh;
+    for (int i = 0; i < kMessages; ++i) {
+        QString buffer;
+        MessageCodec::WriteJson(payload, buffer);
+    }
+    fresh.report("jsonBuffer/fresh");
+
+    QString buffer;
+    buffer.reserve(MessageCodec::kBufferReserve);
+    Throughput reused;
+    for (int i = 0; i < kMessages; ++i) {
+        buffer.truncate(0);
+        MessageCodec::WriteJson(payload, buffer);
+    }
+    reused.report("jsonBuffer/reused");
+
+    QVERIFY(reused.allocations() < fresh.allocations());
+}
+
+QTEST_MAIN(tst_Messaging)
+
+#include "tst_messaging.moc"
@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = tst_renderformat
+CONFIG += warn_on
+QT += testlib
+SOURCES += tst_renderformat.cpp
+
+target.path = /opt/tests/qtmozembed/benchmarks
+INSTALLS += target
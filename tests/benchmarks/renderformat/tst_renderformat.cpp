@@ -0,0 +1,112 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Measures the cost QGraphicsMozView pays in paint for each software back
+// buffer format: clearing the dirty area and copying the frame to the target.
+
+#include <QtTest/QtTest>
+#include <QImage>
+#include <QPainter>
+#include <QPixmap>
+
+Q_DECLARE_METATYPE(QImage::Format)
+
+static const QSize kFrameSize(854, 480);
+
+class tst_RenderFormat : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void clear_data();
+    void clear();
+    void drawToImage_data();
+    void drawToImage();
+    void drawToPixmap_data();
+    void drawToPixmap();
+
+private:
+    void addFormats();
+};
+
+void tst_RenderFormat::addFormats()
+{
+    QTest::addColumn<QImage::Format>("format");
+
+    QTest::newRow("RGB16") << QImage::Format_RGB16;
+    QTest::newRow("RGB32") << QImage::Format_RGB32;
+    QTest::newRow("ARGB32_Premultiplied") << QImage::Format_ARGB32_Premultiplied;
+}
+
+void tst_RenderFormat::clear_data()
+{
+    addFormats();
+}
+
+void tst_RenderFormat::clear()
+{
+    QFETCH(QImage::Format, format);
+
+    QImage buffer(kFrameSize, format);
+    QBENCHMARK {
+        QPainter p(&buffer);
+        p.setCompositionMode(QPainter::CompositionMode_Source);
+        p.fillRect(buffer.rect(), Qt::white);
+    }
+}
+
+void tst_RenderFormat::drawToImage_data()
+{
+    QTest::addColumn<QImage::Format>("format");
+    QTest::addColumn<QImage::Format>("target");
+
+    QList<QImage::Format> formats;
+    formats << QImage::Format_RGB16 << QImage::Format_RGB32 << QImage::Format_ARGB32_Premultiplied;
+    const char* names[] = { "RGB16", "RGB32", "ARGB32_Premultiplied" };
+    for (int i = 0; i < formats.size(); ++i) {
+        for (int j = 0; j < formats.size(); ++j) {
+            QString tag = QString("%1 to %2").arg(names[i]).arg(names[j]);
+            QTest::newRow(tag.toLatin1().constData()) << formats[i] << formats[j];
+        }
+    }
+}
+
+void tst_RenderFormat::drawToImage()
+{
+    QFETCH(QImage::Format, format);
+    QFETCH(QImage::Format, target);
+
+    QImage buffer(kFrameSize, format);
+    buffer.fill(Qt::white);
+    QImage device(kFrameSize, target);
+    QPainter p(&device);
+    QBENCHMARK {
+        p.drawImage(QPoint(0, 0), buffer);
+    }
+}
+
+void tst_RenderFormat::drawToPixmap_data()
+{
+    addFormats();
+}
+
+void tst_RenderFormat::drawToPixmap()
+{
+    QFETCH(QImage::Format, format);
+
+    // Pixmap uses the native format of the display, as the viewport does
+    QImage buffer(kFrameSize, format);
+    buffer.fill(Qt::white);
+    QPixmap device(kFrameSize);
+    QPainter p(&device);
+    QBENCHMARK {
+        p.drawImage(QPoint(0, 0), buffer);
+    }
+}
+
+QTEST_MAIN(tst_RenderFormat)
+
+#include "tst_renderformat.moc"
@@ -114,6 +114,8 @@ int main(int argc, char **argv)
     gargc = argc;
     gargv = argv;
 
+    // Gecko loads while the application sets up
+    QMozContext::preload();
     {
         QApplication app(argc, argv);
         {
@@ -0,0 +1,64 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef STUB_INPUTDATA_H
+#define STUB_INPUTDATA_H
+
+#include <QList>
+#include <stdint.h>
+#include "gfxtypes.h"
+
+namespace mozilla {
+
+class InputData
+{
+public:
+    virtual ~InputData() {}
+};
+
+struct SingleTouchData
+{
+    SingleTouchData(int32_t aIdentifier, nsIntPoint aScreenPoint, nsIntPoint aRadius,
+                    float aRotationAngle, float aForce)
+      : mIdentifier(aIdentifier), mScreenPoint(aScreenPoint), mRadius(aRadius)
+      , mRotationAngle(aRotationAngle), mForce(aForce) {}
+    int32_t mIdentifier;
+    nsIntPoint mScreenPoint;
+    nsIntPoint mRadius;
+    float mRotationAngle;
+    float mForce;
+};
+
+template<class T>
+class StubArray : public QList<T>
+{
+public:
+    void AppendElement(const T& aItem) { this->append(aItem); }
+    int Length() const { return this->size(); }
+};
+
+class MultiTouchInput : public InputData
+{
+public:
+    enum MultiTouchType {
+        MULTITOUCH_START,
+        MULTITOUCH_MOVE,
+        MULTITOUCH_END,
+        MULTITOUCH_ENTER,
+        MULTITOUCH_LEAVE,
+        MULTITOUCH_CANCEL
+    };
+
+    MultiTouchInput(MultiTouchType aType, uint32_t aTime) : mType(aType), mTime(aTime) {}
+
+    MultiTouchType mType;
+    uint32_t mTime;
+    StubArray<SingleTouchData> mTouches;
+};
+
+} // namespace mozilla
+
+#endif
@@ -0,0 +1,49 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef STUB_GFXTYPES_H
+#define STUB_GFXTYPES_H
+
+struct nsIntPoint
+{
+    nsIntPoint(int aX = 0, int aY = 0) : x(aX), y(aY) {}
+    int x, y;
+};
+
+struct nsIntRect
+{
+    nsIntRect(int aX = 0, int aY = 0, int aWidth = 0, int aHeight = 0)
+      : x(aX), y(aY), width(aWidth), height(aHeight) {}
+    int x, y, width, height;
+};
+
+struct gfxPoint
+{
+    gfxPoint(double aX = 0, double aY = 0) : x(aX), y(aY) {}
+    double x, y;
+};
+
+struct gfxSize
+{
+    gfxSize(double aWidth = 0, double aHeight = 0) : width(aWidth), height(aHeight) {}
+    double width, height;
+};
+
+struct gfxRect
+{
+    gfxRect(double aX = 0, double aY = 0, double aWidth = 0, double aHeight = 0)
+      : x(aX), y(aY), width(aWidth), height(aHeight) {}
+    double x, y, width, height;
+};
+
+struct gfxMatrix
+{
+    gfxMatrix(double a = 1, double b = 0, double c = 0, double d = 1, double aX0 = 0, double aY0 = 0)
+      : xx(a), yx(b), xy(c), yy(d), x0(aX0), y0(aY0) {}
+    double xx, yx, xy, yy, x0, y0;
+};
+
+#endif
@@ -0,0 +1,15 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef STUB_EMBEDINITGLUE_H
+#define STUB_EMBEDINITGLUE_H
+
+#include "mozilla/embedlite/EmbedLiteApp.h"
+
+bool LoadEmbedLite(int argc = 0, char** argv = 0);
+mozilla::embedlite::EmbedLiteApp* XRE_GetEmbedLite();
+
+#endif
@@ -0,0 +1,99 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef STUB_EMBEDLITEAPP_H
+#define STUB_EMBEDLITEAPP_H
+
+#include "nscore.h"
+#include "mozilla/embedlite/EmbedLiteView.h"
+
+namespace mozilla {
+namespace embedlite {
+
+class EmbedLiteAppListener
+{
+public:
+    virtual ~EmbedLiteAppListener() {}
+    virtual bool ExecuteChildThread() { return false; }
+    virtual bool StopChildThread() { return false; }
+    virtual void Initialized() {}
+    virtual void Destroyed() {}
+    virtual void OnObserve(const char* aTopic, const PRUnichar* aData) {}
+    virtual uint32_t CreateNewWindowRequested(const uint32_t& aChromeFlags, const char* aURI,
+                                              const uint32_t& aContextFlags, EmbedLiteView* aParentView) { return 0; }
+};
+
+// Records what the library asks of the app instead of forwarding to Gecko
+class EmbedLiteApp
+{
+public:
+    enum EmbedType {
+        EMBED_INVALID,
+        EMBED_THREAD,
+        EMBED_PROCESS
+    };
+    enum RenderType {
+        RENDER_AUTO,
+        RENDER_SW,
+        RENDER_HW
+    };
+
+    EmbedLiteApp()
+      : mListener(0), mAccelerated(false), mNextViewID(1), mLastView(0)
+      , mObserves(0), mObserveBytes(0), mObservers(0) {}
+
+    void SetListener(EmbedLiteAppListener* aListener) { mListener = aListener; }
+    EmbedLiteAppListener* GetListener() const { return mListener; }
+
+    bool Start(EmbedType aType) { return true; }
+    void Stop() {}
+    bool StartChildThread() { return true; }
+    bool StopChildThread() { return true; }
+
+    EmbedLiteView* CreateView(uint32_t aParent = 0)
+    {
+        mLastView = new EmbedLiteView(mNextViewID++);
+        return mLastView;
+    }
+    void DestroyView(EmbedLiteView* aView)
+    {
+        if (aView == mLastView) {
+            mLastView = 0;
+        }
+        delete aView;
+    }
+
+    void SetIsAccelerated(bool aAccelerated) { mAccelerated = aAccelerated; }
+    bool IsAccelerated() const { return mAccelerated; }
+    RenderType GetRenderType() const { return RENDER_SW; }
+    void LoadGlobalStyleSheet(const char* aURI, bool aEnable) {}
+    void AddManifestLocation(const char* aManifest) {}
+
+    void SetBoolPref(const char* aName, bool aValue) {}
+    void SetCharPref(const char* aName, const char* aValue) {}
+    void SetIntPref(const char* aName, int aValue) {}
+
+    void AddObserver(const char* aTopic) { mObservers++; }
+    void RemoveObserver(const char* aTopic) { mObservers--; }
+    void SendObserve(const char* aTopic, const PRUnichar* aData)
+    {
+        mObserves++;
+        mObserveBytes += nsDependentString(aData).Length() * sizeof(PRUnichar);
+    }
+
+    EmbedLiteAppListener* mListener;
+    bool mAccelerated;
+    uint32_t mNextViewID;
+    EmbedLiteView* mLastView;
+    quint64 mObserves;
+    quint64 mObserveBytes;
+    int mObservers;
+};
+
+} // namespace embedlite
+} // namespace mozilla
+
+#endif
@@ -0,0 +1,97 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef STUB_EMBEDLITEVIEW_H
+#define STUB_EMBEDLITEVIEW_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QStringList>
+#include "nscore.h"
+#include "nsStringGlue.h"
+#include "gfxtypes.h"
+
+namespace mozilla {
+class InputData;
+namespace embedlite {
+
+class EmbedLiteViewListener
+{
+public:
+    virtual ~EmbedLiteViewListener() {}
+    virtual void ViewInitialized() {}
+    virtual void ViewDestroyed() {}
+    virtual bool Invalidate() { return false; }
+    virtual void SetBackgroundColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {}
+    virtual void OnLocationChanged(const char* aLocation, bool aCanGoBack, bool aCanGoForward) {}
+    virtual void OnLoadStarted(const char* aLocation) {}
+    virtual void OnLoadFinished(void) {}
+    virtual void OnFirstPaint(int32_t aX, int32_t aY) {}
+    virtual void RecvAsyncMessage(const PRUnichar* aMessage, const PRUnichar* aData) {}
+    virtual char* RecvSyncMessage(const PRUnichar* aMessage, const PRUnichar* aData) { return 0; }
+};
+
+// Records what the library asks of the view instead of forwarding to Gecko
+class EmbedLiteView
+{
+public:
+    explicit EmbedLiteView(uint32_t aUniqueID)
+      : mListener(0), mUniqueID(aUniqueID), mSentMessages(0), mSentBytes(0)
+      , mActive(false), mStops(0), mRecordSent(false) {}
+    virtual ~EmbedLiteView() {}
+
+    void SetListener(EmbedLiteViewListener* aListener) { mListener = aListener; }
+    EmbedLiteViewListener* GetListener() const { return mListener; }
+    uint32_t GetUniqueID() const { return mUniqueID; }
+
+    void LoadURL(const char* aUrl) { mUrl = aUrl; }
+    void GoBack() {}
+    void GoForward() {}
+    void StopLoad() { mStops++; }
+    void Reload(bool aHard) {}
+    void SetIsActive(bool aActive) { mActive = aActive; }
+    void SuspendTimeouts() {}
+    void ResumeTimeouts() {}
+    void LoadFrameScript(const char* aURI) {}
+    void AddMessageListener(const char* aName) { mListened.append(QString::fromUtf8(aName)); }
+    void SendAsyncMessage(const PRUnichar* aMessageName, const PRUnichar* aMessage)
+    {
+        mSentMessages++;
+        mSentBytes += nsDependentString(aMessage).Length() * sizeof(PRUnichar);
+        if (mRecordSent) {
+            mSentNames.append(QString::fromUtf16(aMessageName));
+            mSentData.append(QString::fromUtf16(aMessage));
+        }
+    }
+    bool RenderToImage(unsigned char* aData, int aWidth, int aHeight, int aStride, int aDepth) { return false; }
+    bool RenderGL() { return false; }
+    void SetViewSize(int aWidth, int aHeight) {}
+    void SetGLViewPortSize(int aWidth, int aHeight) {}
+    void SetGLViewTransform(gfxMatrix aMatrix) {}
+    void SetViewClipping(int aX, int aY, int aWidth, int aHeight) {}
+    void SendTextEvent(const char* aComposite, const char* aPreEdit) {}
+    void SendKeyPress(int aDomKeyCode, int aModifiers, int aCharCode) {}
+    void SendKeyRelease(int aDomKeyCode, int aModifiers, int aCharCode) {}
+    void ReceiveInputEvent(const mozilla::InputData& aEvent) {}
+
+    EmbedLiteViewListener* mListener;
+    uint32_t mUniqueID;
+    quint64 mSentMessages;
+    quint64 mSentBytes;
+    QByteArray mUrl;
+    bool mActive;
+    int mStops;
+    // Off by default, recording allocates for every message
+    bool mRecordSent;
+    QStringList mSentNames;
+    QStringList mSentData;
+    QStringList mListened;
+};
+
+} // namespace embedlite
+} // namespace mozilla
+
+#endif
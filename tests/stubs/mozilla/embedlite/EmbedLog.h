@@ -0,0 +1,17 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef STUB_EMBEDLOG_H
+#define STUB_EMBEDLOG_H
+
+// Logging compiled out, as in release builds
+#define LOGT(...) do { } while (0)
+#define LOGF(...) do { } while (0)
+#define LOGW(...) do { } while (0)
+#define LOGE(...) do { } while (0)
+#define LOGNI(...) do { } while (0)
+
+#endif
@@ -0,0 +1,14 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef STUB_NSDEBUG_H
+#define STUB_NSDEBUG_H
+
+#define NS_ASSERTION(expr, str) do { (void)(expr); } while (0)
+#define NS_ERROR(str) do { } while (0)
+#define NS_WARNING(str) do { } while (0)
+
+#endif
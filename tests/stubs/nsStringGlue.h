@@ -0,0 +1,54 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef STUB_NSSTRINGGLUE_H
+#define STUB_NSSTRINGGLUE_H
+
+#include <QByteArray>
+#include <QString>
+#include "nscore.h"
+
+class nsDependentString
+{
+public:
+    explicit nsDependentString(const PRUnichar* aData)
+      : mData(aData), mLength(0)
+    {
+        while (mData && mData[mLength]) {
+            ++mLength;
+        }
+    }
+    const PRUnichar* get() const { return mData; }
+    uint32_t Length() const { return mLength; }
+
+private:
+    const PRUnichar* mData;
+    uint32_t mLength;
+};
+
+class NS_ConvertUTF16toUTF8
+{
+public:
+    explicit NS_ConvertUTF16toUTF8(const PRUnichar* aData)
+      : mData(QString::fromUtf16(aData).toUtf8()) {}
+    const char* get() const { return mData.constData(); }
+
+private:
+    QByteArray mData;
+};
+
+class NS_ConvertUTF8toUTF16
+{
+public:
+    explicit NS_ConvertUTF8toUTF16(const char* aData)
+      : mData(QString::fromUtf8(aData)) {}
+    const PRUnichar* get() const { return mData.utf16(); }
+
+private:
+    QString mData;
+};
+
+#endif
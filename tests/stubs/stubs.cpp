@@ -0,0 +1,31 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "mozilla/embedlite/EmbedInitGlue.h"
+#include "EmbedQtKeyUtils.h"
+
+using namespace mozilla::embedlite;
+
+bool LoadEmbedLite(int argc, char** argv)
+{
+    return true;
+}
+
+EmbedLiteApp* XRE_GetEmbedLite()
+{
+    static EmbedLiteApp sApp;
+    return &sApp;
+}
+
+// Key handling is not exercised, keep EmbedQtKeyUtils.cpp and its DOM
+// headers out of the benchmark
+int MozKey::QtModifierToDOMModifier(int aModifiers) { return 0; }
+int MozKey::QtKeyCodeToDOMKeyCode(int aKeysym, int aModifiers) { return 0; }
+int MozKey::DOMKeyCodeToQtKeyCode(int aKeysym) { return 0; }
+uint32_t* MozKey::GetFlagWord32(uint32_t aKeyCode, uint32_t* aMask) { return 0; }
+bool MozKey::IsKeyDown(uint32_t aKeyCode) { return false; }
+void MozKey::SetKeyDownFlag(uint32_t aKeyCode) {}
+void MozKey::ClearKeyDownFlag(uint32_t aKeyCode) {}
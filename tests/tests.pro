@@ -1,6 +1,6 @@
 TEMPLATE = subdirs
 
-SUBDIRS = imports qmlmoztestrunner
+SUBDIRS = imports qmlmoztestrunner benchmarks unit
 
 OTHER_FILES += auto/* auto/scripts/*
 
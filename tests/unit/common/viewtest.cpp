@@ -0,0 +1,59 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QCoreApplication>
+
+#include "viewtest.h"
+#include "qgraphicsmozview.h"
+#include "qmozcontext.h"
+#include "mozilla/embedlite/EmbedLiteApp.h"
+#include "mozilla/embedlite/EmbedInitGlue.h"
+
+using namespace mozilla::embedlite;
+
+ViewTest::ViewTest()
+    : mView(0)
+    , mGeckoView(0)
+{
+}
+
+EmbedLiteApp* ViewTest::app() const
+{
+    return XRE_GetEmbedLite();
+}
+
+bool ViewTest::initContext()
+{
+    QMozContext::GetInstance();
+    app()->GetListener()->Initialized();
+    return QMozContext::GetInstance()->initialized();
+}
+
+bool ViewTest::createView()
+{
+    mView = new QGraphicsMozView();
+    // The view creates its Gecko view from a zero timer
+    QCoreApplication::processEvents();
+    mGeckoView = app()->mLastView;
+    if (!mGeckoView) {
+        return false;
+    }
+    mGeckoView->GetListener()->ViewInitialized();
+    return true;
+}
+
+void ViewTest::destroyView()
+{
+    delete mView;
+    mView = 0;
+    mGeckoView = 0;
+}
+
+void ViewTest::receive(const QString& aName, const QString& aJson)
+{
+    mGeckoView->GetListener()->RecvAsyncMessage((const PRUnichar*)aName.utf16(),
+                                                (const PRUnichar*)aJson.utf16());
+}
@@ -0,0 +1,45 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef VIEWTEST_H
+#define VIEWTEST_H
+
+#include <QObject>
+
+class QGraphicsMozView;
+namespace mozilla {
+namespace embedlite {
+class EmbedLiteApp;
+class EmbedLiteView;
+}
+}
+
+/*!
+ * Base of the tests driving a QGraphicsMozView through the stub Gecko app.
+ * Helpers are not slots, QTest would run them as test functions.
+ */
+class ViewTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    ViewTest();
+
+protected:
+    mozilla::embedlite::EmbedLiteApp* app() const;
+    // Starts QMozContext, call from initTestCase()
+    bool initContext();
+    // Creates mView and initializes its Gecko side mGeckoView
+    bool createView();
+    void destroyView();
+    // Delivers aJson to mView as if content sent it as aName
+    void receive(const QString& aName, const QString& aJson);
+
+    QGraphicsMozView* mView;
+    mozilla::embedlite::EmbedLiteView* mGeckoView;
+};
+
+#endif
@@ -0,0 +1,7 @@
+include(../unit.pri)
+
+TARGET = tst_framescheduler
+
+SOURCES += tst_framescheduler.cpp \
+           $$SRC_DIR/framescheduler.cpp
+HEADERS += $$SRC_DIR/framescheduler.h
@@ -0,0 +1,151 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+#include <QElapsedTimer>
+
+#include "framescheduler.h"
+
+// Asks for a new frame as soon as one was delivered, like a page running
+// an animation
+class Client : public QObject, public FrameSchedulerClient
+{
+    Q_OBJECT
+
+public:
+    Client(FrameScheduler* aScheduler)
+        : mScheduler(aScheduler), mFrames(0), mActive(true), mContinuous(false) {}
+
+    virtual void ScheduledFrame() {
+        mFrames++;
+        if (mContinuous) {
+            QMetaObject::invokeMethod(this, "present", Qt::QueuedConnection);
+        }
+    }
+    virtual bool IsFrameActive() const { return mActive; }
+
+public Q_SLOTS:
+    void present() {
+        mScheduler->framePresented(this);
+        mScheduler->scheduleFrame(this);
+    }
+
+public:
+    FrameScheduler* mScheduler;
+    int mFrames;
+    bool mActive;
+    bool mContinuous;
+};
+
+class tst_FrameScheduler : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void pacing_data();
+    void pacing();
+    void zeroRateDisablesPacing();
+    void vsyncDriven();
+    void vsyncTimeout();
+    void coalescing();
+};
+
+void tst_FrameScheduler::pacing_data()
+{
+    QTest::addColumn<int>("fps");
+    QTest::newRow("30") << 30;
+    QTest::newRow("60") << 60;
+}
+
+void tst_FrameScheduler::pacing()
+{
+    QFETCH(int, fps);
+    FrameScheduler scheduler;
+    scheduler.setTargetFrameRate(fps);
+    Client client(&scheduler);
+    client.mContinuous = true;
+
+    QElapsedTimer timer;
+    timer.start();
+    scheduler.scheduleFrame(&client);
+    QTest::qWait(1000);
+    client.mContinuous = false;
+    double rate = client.mFrames * 1000.0 / timer.elapsed();
+
+    // Never above the target, 1000 / 60 truncated to 16ms would give 62.5
+    QVERIFY2(rate <= fps + 0.5, qPrintable(QString("%1 fps").arg(rate)));
+    QVERIFY2(rate >= fps * 0.85, qPrintable(QString("%1 fps").arg(rate)));
+}
+
+void tst_FrameScheduler::zeroRateDisablesPacing()
+{
+    FrameScheduler scheduler;
+    scheduler.setTargetFrameRate(0);
+    Client client(&scheduler);
+    client.mContinuous = true;
+
+    scheduler.scheduleFrame(&client);
+    QTest::qWait(200);
+    client.mContinuous = false;
+
+    // 60 fps pacing would allow 12 frames here
+    QVERIFY2(client.mFrames > 24, qPrintable(QString::number(client.mFrames)));
+}
+
+void tst_FrameScheduler::vsyncDriven()
+{
+    FrameScheduler scheduler;
+    scheduler.setVsyncDriven(true);
+    Client client(&scheduler);
+
+    scheduler.scheduleFrame(&client);
+    QTest::qWait(20);
+    QCOMPARE(client.mFrames, 0);
+
+    scheduler.vsync();
+    QCOMPARE(client.mFrames, 1);
+
+    // Nothing pending, vsync alone doesn't produce frames
+    scheduler.framePresented(&client);
+    scheduler.vsync();
+    QCOMPARE(client.mFrames, 1);
+    QTest::qWait(100);
+    QCOMPARE(client.mFrames, 1);
+
+    scheduler.setVsyncDriven(false);
+    scheduler.scheduleFrame(&client);
+    QTest::qWait(100);
+    QCOMPARE(client.mFrames, 2);
+}
+
+void tst_FrameScheduler::vsyncTimeout()
+{
+    FrameScheduler scheduler;
+    scheduler.setVsyncDriven(true);
+    Client client(&scheduler);
+
+    // Idle display, no vsync() will come until something renders
+    scheduler.scheduleFrame(&client);
+    QTest::qWait(100);
+    QCOMPARE(client.mFrames, 1);
+}
+
+void tst_FrameScheduler::coalescing()
+{
+    FrameScheduler scheduler;
+    Client client(&scheduler);
+
+    scheduler.scheduleFrame(&client);
+    scheduler.scheduleFrame(&client);
+    scheduler.scheduleFrame(&client);
+    QTest::qWait(100);
+    QCOMPARE(client.mFrames, 1);
+    QCOMPARE(scheduler.statistics().value("coalesced").toInt(), 2);
+}
+
+QTEST_MAIN(tst_FrameScheduler)
+
+#include "tst_framescheduler.moc"
@@ -0,0 +1,10 @@
+include(../unit.pri)
+
+TARGET = tst_headlessview
+QT += opengl
+
+SOURCES += tst_headlessview.cpp \
+           $$CONTEXT_SOURCES \
+           $$SRC_DIR/qmozheadlessview.cpp
+HEADERS += $$CONTEXT_HEADERS \
+           $$SRC_DIR/qmozheadlessview.h
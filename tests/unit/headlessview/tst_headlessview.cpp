@@ -0,0 +1,138 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+
+#include "qmozcontext.h"
+#include "qmozheadlessview.h"
+#include "mozilla/embedlite/EmbedLiteApp.h"
+#include "mozilla/embedlite/EmbedInitGlue.h"
+
+using namespace mozilla::embedlite;
+
+class tst_HeadlessView : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_HeadlessView() : mView(0), mGeckoView(0) {}
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void activeOnInitialize();
+    void loadBeforeInitialize();
+    void readyAfterPaintAndLoad();
+    void ignoresPreviousPage();
+    void notReadyWhileResizing();
+
+private:
+    EmbedLiteApp* app() const { return XRE_GetEmbedLite(); }
+    EmbedLiteViewListener* gecko() const { return mGeckoView->GetListener(); }
+    void createView();
+
+    QMozHeadlessView* mView;
+    EmbedLiteView* mGeckoView;
+};
+
+void tst_HeadlessView::initTestCase()
+{
+    QMozContext::GetInstance();
+    app()->GetListener()->Initialized();
+    QVERIFY(QMozContext::GetInstance()->initialized());
+}
+
+void tst_HeadlessView::createView()
+{
+    mView = new QMozHeadlessView(QSize(320, 240));
+    QCoreApplication::processEvents();
+    mGeckoView = app()->mLastView;
+    QVERIFY(mGeckoView);
+}
+
+void tst_HeadlessView::init()
+{
+    createView();
+}
+
+void tst_HeadlessView::cleanup()
+{
+    delete mView;
+    mView = 0;
+    mGeckoView = 0;
+}
+
+void tst_HeadlessView::activeOnInitialize()
+{
+    QVERIFY(!mGeckoView->mActive);
+    gecko()->ViewInitialized();
+    QVERIFY(mGeckoView->mActive);
+}
+
+void tst_HeadlessView::loadBeforeInitialize()
+{
+    mView->load("http://example.com/a");
+    QVERIFY(mGeckoView->mUrl.isEmpty());
+    gecko()->ViewInitialized();
+    QCOMPARE(mGeckoView->mUrl, QByteArray("http://example.com/a"));
+}
+
+void tst_HeadlessView::readyAfterPaintAndLoad()
+{
+    gecko()->ViewInitialized();
+    QSignalSpy ready(mView, SIGNAL(ready()));
+    mView->load("http://example.com/a");
+    gecko()->OnLoadStarted("http://example.com/a");
+    gecko()->OnFirstPaint(0, 0);
+    QVERIFY(!mView->isReady());
+    gecko()->OnLoadFinished();
+    QVERIFY(mView->isReady());
+    QCOMPARE(ready.count(), 1);
+    QCOMPARE(mView->snapshot().size(), QSize(320, 240));
+}
+
+void tst_HeadlessView::ignoresPreviousPage()
+{
+    gecko()->ViewInitialized();
+    QSignalSpy ready(mView, SIGNAL(ready()));
+    mView->load("http://example.com/a");
+    gecko()->OnLoadStarted("http://example.com/a");
+
+    // Page a paints and finishes after b was already requested
+    mView->load("http://example.com/b");
+    gecko()->OnFirstPaint(0, 0);
+    gecko()->OnLoadFinished();
+    QVERIFY(!mView->isReady());
+    QCOMPARE(ready.count(), 0);
+
+    gecko()->OnLoadStarted("http://example.com/b");
+    QVERIFY(!mView->isReady());
+    gecko()->OnFirstPaint(0, 0);
+    gecko()->OnLoadFinished();
+    QVERIFY(mView->isReady());
+    QCOMPARE(ready.count(), 1);
+}
+
+void tst_HeadlessView::notReadyWhileResizing()
+{
+    gecko()->ViewInitialized();
+    mView->load("http://example.com/a");
+    gecko()->OnLoadStarted("http://example.com/a");
+    gecko()->OnFirstPaint(0, 0);
+    gecko()->OnLoadFinished();
+    QVERIFY(mView->isReady());
+
+    mView->setSize(QSize(640, 480));
+    QVERIFY(!mView->isReady());
+    gecko()->Invalidate();
+    QVERIFY(mView->isReady());
+    QCOMPARE(mView->snapshot().size(), QSize(640, 480));
+}
+
+QTEST_MAIN(tst_HeadlessView)
+
+#include "tst_headlessview.moc"
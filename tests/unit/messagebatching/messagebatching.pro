@@ -0,0 +1,8 @@
+include(../unit.pri)
+
+TARGET = tst_messagebatching
+QT += opengl
+
+SOURCES += tst_messagebatching.cpp \
+           $$VIEW_SOURCES
+HEADERS += $$VIEW_HEADERS
@@ -0,0 +1,132 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+
+#include "qgraphicsmozview.h"
+#include "messagecodec.h"
+#include "viewtest.h"
+#include "mozilla/embedlite/EmbedLiteView.h"
+
+class tst_MessageBatching : public ViewTest
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void unconfirmedNamesAreNotBatched();
+    void batchArrives();
+    void loneMessageIsNotWrapped();
+    void unbatchedNameKeepsOrder();
+    void disablingFlushes();
+
+private:
+    // What MessageCodec.addBatchListener() sends from the frame script
+    void confirm(const QStringList& aNames);
+    void send(const QString& aName, int aSeq);
+    // Entries of the envelope at aIndex as "name:seq"
+    QStringList entries(int aIndex) const;
+};
+
+void tst_MessageBatching::initTestCase()
+{
+    QVERIFY(initContext());
+}
+
+void tst_MessageBatching::init()
+{
+    QVERIFY(createView());
+    mGeckoView->mRecordSent = true;
+    mView->setMessageBatching(true);
+}
+
+void tst_MessageBatching::cleanup()
+{
+    destroyView();
+}
+
+void tst_MessageBatching::confirm(const QStringList& aNames)
+{
+    receive("embed:batch-ready", QString("{\"names\":[\"%1\"]}").arg(aNames.join("\",\"")));
+}
+
+void tst_MessageBatching::send(const QString& aName, int aSeq)
+{
+    QVariantMap data;
+    data.insert("seq", aSeq);
+    mView->sendAsyncMessage(aName, data);
+}
+
+QStringList tst_MessageBatching::entries(int aIndex) const
+{
+    QString json = mGeckoView->mSentData.at(aIndex);
+    bool ok = false;
+    QVariant batch = MessageCodec::DecodeJson(json.constData(), json.size(), &ok);
+    QStringList result;
+    Q_FOREACH(const QVariant& entry, batch.toList()) {
+        QVariantMap map = entry.toMap();
+        result.append(QString("%1:%2").arg(map.value("name").toString())
+                                      .arg(map.value("data").toMap().value("seq").toInt()));
+    }
+    return result;
+}
+
+void tst_MessageBatching::unconfirmedNamesAreNotBatched()
+{
+    // No frame script unpacks these, an envelope would lose them
+    send("test:a", 0);
+    send("test:a", 1);
+    QCOMPARE(mGeckoView->mSentNames, QStringList() << "test:a" << "test:a");
+    QCoreApplication::processEvents();
+    QCOMPARE(mGeckoView->mSentNames.size(), 2);
+}
+
+void tst_MessageBatching::batchArrives()
+{
+    confirm(QStringList() << "test:a" << "test:b");
+    send("test:a", 0);
+    send("test:b", 1);
+    send("test:a", 2);
+    QVERIFY(mGeckoView->mSentNames.isEmpty());
+
+    QTRY_COMPARE(mGeckoView->mSentNames, QStringList() << "embed:batch");
+    QCOMPARE(entries(0), QStringList() << "test:a:0" << "test:b:1" << "test:a:2");
+}
+
+void tst_MessageBatching::loneMessageIsNotWrapped()
+{
+    confirm(QStringList() << "test:a");
+    send("test:a", 0);
+    QTRY_COMPARE(mGeckoView->mSentNames, QStringList() << "test:a");
+}
+
+void tst_MessageBatching::unbatchedNameKeepsOrder()
+{
+    confirm(QStringList() << "test:a");
+    send("test:a", 0);
+    send("test:a", 1);
+    // Not confirmed, goes out right away but after what is queued
+    send("test:other", 2);
+    QCOMPARE(mGeckoView->mSentNames, QStringList() << "embed:batch" << "test:other");
+    QCOMPARE(entries(0), QStringList() << "test:a:0" << "test:a:1");
+}
+
+void tst_MessageBatching::disablingFlushes()
+{
+    confirm(QStringList() << "test:a");
+    send("test:a", 0);
+    send("test:a", 1);
+    mView->setMessageBatching(false);
+    QCOMPARE(mGeckoView->mSentNames, QStringList() << "embed:batch");
+    send("test:a", 2);
+    QCOMPARE(mGeckoView->mSentNames, QStringList() << "embed:batch" << "test:a");
+}
+
+QTEST_MAIN(tst_MessageBatching)
+
+#include "tst_messagebatching.moc"
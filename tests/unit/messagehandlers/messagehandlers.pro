@@ -0,0 +1,8 @@
+include(../unit.pri)
+
+TARGET = tst_messagehandlers
+QT += opengl
+
+SOURCES += tst_messagehandlers.cpp \
+           $$VIEW_SOURCES
+HEADERS += $$VIEW_HEADERS
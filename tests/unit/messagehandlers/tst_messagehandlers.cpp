@@ -0,0 +1,122 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+#include <QPointer>
+
+#include "qgraphicsmozview.h"
+#include "viewtest.h"
+#include "mozilla/embedlite/EmbedLiteView.h"
+
+class Receiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    Receiver() : mCalls(0) {}
+
+    int mCalls;
+    // Deleted from within onMessage()
+    QPointer<QObject> mVictim;
+
+public Q_SLOTS:
+    void onMessage(const QString& aName, const QVariant& aData)
+    {
+        mCalls++;
+        delete mVictim;
+    }
+};
+
+class tst_MessageHandlers : public ViewTest
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void deletedReceiverIsDropped();
+    void receiverDeletedDuringDispatch();
+    void otherReceiversKeepTheirNames();
+
+private:
+    void receive(const QString& aName);
+};
+
+void tst_MessageHandlers::initTestCase()
+{
+    QVERIFY(initContext());
+}
+
+void tst_MessageHandlers::init()
+{
+    QVERIFY(createView());
+    mGeckoView->mListened.clear();
+}
+
+void tst_MessageHandlers::cleanup()
+{
+    destroyView();
+}
+
+void tst_MessageHandlers::receive(const QString& aName)
+{
+    ViewTest::receive(aName, "{}");
+}
+
+void tst_MessageHandlers::deletedReceiverIsDropped()
+{
+    Receiver* first = new Receiver;
+    QVERIFY(mView->registerMessageHandler("test:a", first, "onMessage"));
+    QCOMPARE(mGeckoView->mListened, QStringList() << "test:a");
+    delete first;
+
+    // The name was removed with its last handler, so registering again
+    // starts a fresh entry and asks Gecko for the message once more
+    Receiver second;
+    QVERIFY(mView->registerMessageHandler("test:a", &second, "onMessage"));
+    QCOMPARE(mGeckoView->mListened, QStringList() << "test:a" << "test:a");
+
+    receive("test:a");
+    QCOMPARE(second.mCalls, 1);
+}
+
+void tst_MessageHandlers::receiverDeletedDuringDispatch()
+{
+    Receiver first;
+    Receiver* second = new Receiver;
+    first.mVictim = second;
+    QVERIFY(mView->registerMessageHandler("test:a", &first, "onMessage"));
+    QVERIFY(mView->registerMessageHandler("test:a", second, "onMessage"));
+
+    receive("test:a");
+    QCOMPARE(first.mCalls, 1);
+    QVERIFY(!first.mVictim);
+
+    receive("test:a");
+    QCOMPARE(first.mCalls, 2);
+}
+
+void tst_MessageHandlers::otherReceiversKeepTheirNames()
+{
+    Receiver* gone = new Receiver;
+    Receiver kept;
+    QVERIFY(mView->registerMessageHandler("test:a", gone, "onMessage"));
+    QVERIFY(mView->registerMessageHandler("test:b", gone, "onMessage"));
+    QVERIFY(mView->registerMessageHandler("test:b", &kept, "onMessage"));
+    delete gone;
+
+    receive("test:b");
+    QCOMPARE(kept.mCalls, 1);
+
+    // test:b still has a handler, no second listener for it
+    QVERIFY(mView->registerMessageHandler("test:b", &kept, "onMessage"));
+    QCOMPARE(mGeckoView->mListened, QStringList() << "test:a" << "test:b");
+}
+
+QTEST_MAIN(tst_MessageHandlers)
+
+#include "tst_messagehandlers.moc"
@@ -0,0 +1,8 @@
+include(../unit.pri)
+
+TARGET = tst_messagelanes
+QT += opengl
+
+SOURCES += tst_messagelanes.cpp \
+           $$VIEW_SOURCES
+HEADERS += $$VIEW_HEADERS
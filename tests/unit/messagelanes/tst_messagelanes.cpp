@@ -0,0 +1,191 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+
+#include "qgraphicsmozview.h"
+#include "viewtest.h"
+#include "mozilla/embedlite/EmbedLiteView.h"
+
+// Matches the lane constants in qgraphicsmozview_p.cpp
+static const int kBudget = 4;
+static const int kMaxDelay = 100;
+static const int kMessages = 10;
+
+class tst_MessageLanes : public ViewTest
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void outgoingBudgetAndOrder();
+    void highPriorityOvertakes();
+    void incomingBudgetAndOrder();
+    void ageOverridesBudget();
+    void backToHighKeepsOrder();
+
+    void onMessage(const QString message, const QVariant data);
+
+private:
+    // One drain pass, without running the event loop
+    void drain();
+    void receive(const QString& aName, int aSeq);
+    QVariantMap lowStatistics() const;
+
+    QList<int> mReceived;
+};
+
+void tst_MessageLanes::initTestCase()
+{
+    QVERIFY(initContext());
+}
+
+void tst_MessageLanes::init()
+{
+    QVERIFY(createView());
+    mGeckoView->mRecordSent = true;
+    mView->setMessagePriority("test:low", "low");
+    connect(mView, SIGNAL(recvAsyncMessage(QString, QVariant)),
+            this, SLOT(onMessage(QString, QVariant)));
+    mReceived.clear();
+}
+
+void tst_MessageLanes::cleanup()
+{
+    destroyView();
+}
+
+void tst_MessageLanes::onMessage(const QString message, const QVariant data)
+{
+    QCOMPARE(message, QString("test:low"));
+    mReceived.append(data.toMap().value("seq").toInt());
+}
+
+void tst_MessageLanes::drain()
+{
+    QMetaObject::invokeMethod(mView, "drainLowPriorityMessages", Qt::DirectConnection);
+}
+
+void tst_MessageLanes::receive(const QString& aName, int aSeq)
+{
+    ViewTest::receive(aName, QString("{\"seq\":%1}").arg(aSeq));
+}
+
+QVariantMap tst_MessageLanes::lowStatistics() const
+{
+    return mView->messageLaneStatistics().value("low").toMap();
+}
+
+static QStringList sequence(int aFrom, int aTo)
+{
+    QStringList list;
+    for (int i = aFrom; i < aTo; ++i) {
+        list.append(QString("{\"seq\":%1}").arg(i));
+    }
+    return list;
+}
+
+void tst_MessageLanes::outgoingBudgetAndOrder()
+{
+    for (int i = 0; i < kMessages; ++i) {
+        QVariantMap data;
+        data.insert("seq", i);
+        mView->sendAsyncMessage("test:low", data);
+    }
+    QCOMPARE(mGeckoView->mSentData.size(), 0);
+    QCOMPARE(lowStatistics().value("outgoingDepth").toInt(), kMessages);
+
+    drain();
+    QCOMPARE(mGeckoView->mSentData, sequence(0, kBudget));
+    drain();
+    QCOMPARE(mGeckoView->mSentData, sequence(0, 2 * kBudget));
+    drain();
+    QCOMPARE(mGeckoView->mSentData, sequence(0, kMessages));
+    QCOMPARE(lowStatistics().value("sent").toInt(), kMessages);
+    QCOMPARE(lowStatistics().value("forcedByAge").toInt(), 0);
+}
+
+void tst_MessageLanes::highPriorityOvertakes()
+{
+    for (int i = 0; i < kMessages; ++i) {
+        QVariantMap data;
+        data.insert("seq", i);
+        mView->sendAsyncMessage("test:low", data);
+    }
+    drain();
+    mView->sendAsyncMessage("test:high", QVariantMap());
+    drain();
+
+    QCOMPARE(mGeckoView->mSentNames.size(), 2 * kBudget + 1);
+    QCOMPARE(mGeckoView->mSentNames.at(kBudget), QString("test:high"));
+    QCOMPARE(mGeckoView->mSentNames.count("test:low"), 2 * kBudget);
+}
+
+void tst_MessageLanes::incomingBudgetAndOrder()
+{
+    for (int i = 0; i < kMessages; ++i) {
+        receive("test:low", i);
+    }
+    QVERIFY(mReceived.isEmpty());
+    QCOMPARE(lowStatistics().value("incomingDepth").toInt(), kMessages);
+
+    drain();
+    QCOMPARE(mReceived.size(), kBudget);
+    drain();
+    drain();
+    QList<int> expected;
+    for (int i = 0; i < kMessages; ++i) {
+        expected.append(i);
+    }
+    QCOMPARE(mReceived, expected);
+    QCOMPARE(lowStatistics().value("received").toInt(), kMessages);
+}
+
+void tst_MessageLanes::ageOverridesBudget()
+{
+    for (int i = 0; i < kMessages; ++i) {
+        QVariantMap data;
+        data.insert("seq", i);
+        mView->sendAsyncMessage("test:low", data);
+        receive("test:low", i);
+    }
+    // Without processing events, no drain runs meanwhile
+    QTest::qSleep(kMaxDelay + 20);
+
+    drain();
+    QCOMPARE(mGeckoView->mSentData, sequence(0, kMessages));
+    QCOMPARE(mReceived.size(), kMessages);
+    QCOMPARE(lowStatistics().value("forcedByAge").toInt(), 2 * (kMessages - kBudget));
+}
+
+void tst_MessageLanes::backToHighKeepsOrder()
+{
+    for (int i = 0; i < kBudget; ++i) {
+        QVariantMap data;
+        data.insert("seq", i);
+        mView->sendAsyncMessage("test:low", data);
+        receive("test:low", i);
+    }
+    mView->setMessagePriority("test:low", "high");
+    QCOMPARE(mGeckoView->mSentData, sequence(0, kBudget));
+    QCOMPARE(mReceived.size(), kBudget);
+
+    // Skips the lane now, after the flushed ones
+    QVariantMap data;
+    data.insert("seq", kBudget);
+    mView->sendAsyncMessage("test:low", data);
+    receive("test:low", kBudget);
+    QCOMPARE(mGeckoView->mSentData, sequence(0, kBudget + 1));
+    QCOMPARE(mReceived.last(), kBudget);
+    QCOMPARE(lowStatistics().value("outgoingDepth").toInt(), 0);
+    QCOMPARE(lowStatistics().value("incomingDepth").toInt(), 0);
+}
+
+QTEST_MAIN(tst_MessageLanes)
+
+#include "tst_messagelanes.moc"
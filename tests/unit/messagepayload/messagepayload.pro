@@ -0,0 +1,8 @@
+include(../unit.pri)
+
+TARGET = tst_messagepayload
+QT += opengl
+
+SOURCES += tst_messagepayload.cpp \
+           $$VIEW_SOURCES
+HEADERS += $$VIEW_HEADERS
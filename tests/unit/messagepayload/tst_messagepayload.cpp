@@ -0,0 +1,147 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+
+#include "qgraphicsmozview.h"
+#include "viewtest.h"
+
+// What a recvAsyncMessagePayload handler saw
+class PayloadProbe : public QObject
+{
+    Q_OBJECT
+
+public:
+    PayloadProbe() : mCalls(0), mTouchData(false), mDecodedBefore(false), mDecodedAfter(false), mRaw(0) {}
+
+public Q_SLOTS:
+    void onPayload(const QString message, QMozMessagePayload* payload) {
+        Q_UNUSED(message);
+        mCalls++;
+        mDecodedBefore = payload->isDecoded();
+        mRawData = payload->rawData();
+        if (mTouchData) {
+            mFirst = payload->data();
+            // Content is gone, a second decode would see the garbage
+            if (mRaw) {
+                mRaw->fill(QChar('#'));
+            }
+            mSecond = payload->data();
+        }
+        mDecodedAfter = payload->isDecoded();
+    }
+
+public:
+    int mCalls;
+    bool mTouchData;
+    bool mDecodedBefore;
+    bool mDecodedAfter;
+    QString* mRaw;
+    QString mRawData;
+    QVariant mFirst;
+    QVariant mSecond;
+};
+
+class tst_MessagePayload : public ViewTest
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void decodedOnAccess();
+    void decodedOnce();
+    void notDecodedWithoutAccess();
+    void invalidPayload();
+    void viewDecodesOnlyForReaders();
+};
+
+void tst_MessagePayload::initTestCase()
+{
+    QVERIFY(initContext());
+    QVERIFY(createView());
+}
+
+void tst_MessagePayload::cleanupTestCase()
+{
+    destroyView();
+}
+
+void tst_MessagePayload::decodedOnAccess()
+{
+    QString raw("{\"x\":1,\"y\":[true,\"two\"]}");
+    QMozMessagePayload payload(raw.constData(), raw.size(), false);
+    QVERIFY(!payload.isDecoded());
+    QCOMPARE(payload.rawData(), raw);
+    QVERIFY(!payload.isDecoded());
+
+    QVERIFY(payload.isValid());
+    QVERIFY(payload.isDecoded());
+    QVariantMap map = payload.data().toMap();
+    QCOMPARE(map.value("x").toInt(), 1);
+    QCOMPARE(map.value("y").toList().at(1).toString(), QString("two"));
+}
+
+void tst_MessagePayload::decodedOnce()
+{
+    QString raw("{\"x\":1}");
+    QMozMessagePayload payload(raw.constData(), raw.size(), false);
+    QVariant first = payload.data();
+    // Overwrite what the payload points to, a second parse would fail
+    raw.fill(QChar('#'));
+    QVERIFY(payload.isValid());
+    QCOMPARE(payload.data(), first);
+}
+
+void tst_MessagePayload::notDecodedWithoutAccess()
+{
+    PayloadProbe probe;
+    connect(mView, SIGNAL(recvAsyncMessagePayload(QString, QMozMessagePayload*)),
+            &probe, SLOT(onPayload(QString, QMozMessagePayload*)));
+    receive("test:payload", "{\"x\":1}");
+    disconnect(mView, 0, &probe, 0);
+
+    QCOMPARE(probe.mCalls, 1);
+    QCOMPARE(probe.mRawData, QString("{\"x\":1}"));
+    QVERIFY(!probe.mDecodedBefore);
+    QVERIFY(!probe.mDecodedAfter);
+}
+
+void tst_MessagePayload::invalidPayload()
+{
+    QString raw("{not json");
+    QMozMessagePayload payload(raw.constData(), raw.size(), false);
+    QVERIFY(!payload.isValid());
+    QVERIFY(payload.isDecoded());
+
+    QString binary("\"nw==\"");
+    QMozMessagePayload truncated(binary.constData(), binary.size(), true);
+    QVERIFY(!truncated.isValid());
+}
+
+void tst_MessagePayload::viewDecodesOnlyForReaders()
+{
+    PayloadProbe probe;
+    probe.mTouchData = true;
+    QString data("{\"x\":2}");
+    probe.mRaw = &data;
+    connect(mView, SIGNAL(recvAsyncMessagePayload(QString, QMozMessagePayload*)),
+            &probe, SLOT(onPayload(QString, QMozMessagePayload*)));
+    // The probe wipes this buffer after the first read, the payload must
+    // not parse it again
+    receive("test:payload", data);
+    disconnect(mView, 0, &probe, 0);
+
+    QCOMPARE(probe.mCalls, 1);
+    QVERIFY(!probe.mDecodedBefore);
+    QVERIFY(probe.mDecodedAfter);
+    QCOMPARE(probe.mFirst.toMap().value("x").toInt(), 2);
+    QCOMPARE(probe.mSecond, probe.mFirst);
+}
+
+QTEST_MAIN(tst_MessagePayload)
+
+#include "tst_messagepayload.moc"
@@ -0,0 +1,8 @@
+include(../unit.pri)
+
+TARGET = tst_observers
+QT += opengl
+
+SOURCES += tst_observers.cpp \
+           $$CONTEXT_SOURCES
+HEADERS += $$CONTEXT_HEADERS
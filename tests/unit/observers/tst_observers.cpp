@@ -0,0 +1,100 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+
+#include "qmozcontext.h"
+#include "mozilla/embedlite/EmbedLiteApp.h"
+#include "mozilla/embedlite/EmbedInitGlue.h"
+
+using namespace mozilla::embedlite;
+
+class tst_Observers : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void subscribedTopic();
+    void subscriptionsAreCounted();
+    void unsubscribedTopicIsDropped();
+    void directlyRegisteredTopic();
+
+private:
+    EmbedLiteApp* app() const { return XRE_GetEmbedLite(); }
+    void observe(const char* aTopic, const QString& aData);
+};
+
+void tst_Observers::initTestCase()
+{
+    QMozContext::GetInstance();
+    app()->GetListener()->Initialized();
+    QVERIFY(QMozContext::GetInstance()->initialized());
+}
+
+void tst_Observers::observe(const char* aTopic, const QString& aData)
+{
+    app()->GetListener()->OnObserve(aTopic, (const PRUnichar*)aData.utf16());
+}
+
+void tst_Observers::subscribedTopic()
+{
+    QMozContext* context = QMozContext::GetInstance();
+    QSignalSpy spy(context, SIGNAL(recvObserve(QString, QVariant)));
+    context->addObserver("test:subscribed");
+
+    observe("test:subscribed", "{\"x\":1}");
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), QString("test:subscribed"));
+    QCOMPARE(spy.at(0).at(1).toMap().value("x").toInt(), 1);
+
+    observe("test:subscribed", "plain");
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(spy.at(1).at(1).toString(), QString("plain"));
+    context->removeObserver("test:subscribed");
+}
+
+void tst_Observers::subscriptionsAreCounted()
+{
+    QMozContext* context = QMozContext::GetInstance();
+    int registered = app()->mObservers;
+    context->addObserver("test:counted");
+    context->addObserver("test:counted");
+    QCOMPARE(app()->mObservers, registered + 1);
+    context->removeObserver("test:counted");
+    QCOMPARE(app()->mObservers, registered + 1);
+    context->removeObserver("test:counted");
+    QCOMPARE(app()->mObservers, registered);
+}
+
+void tst_Observers::unsubscribedTopicIsDropped()
+{
+    QMozContext* context = QMozContext::GetInstance();
+    QSignalSpy spy(context, SIGNAL(recvObserve(QString, QVariant)));
+    context->addObserver("test:dropped");
+    context->removeObserver("test:dropped");
+
+    // Already on its way when the subscription ended
+    observe("test:dropped", "{}");
+    QCOMPARE(spy.count(), 0);
+}
+
+void tst_Observers::directlyRegisteredTopic()
+{
+    QMozContext* context = QMozContext::GetInstance();
+    QSignalSpy spy(context, SIGNAL(recvObserve(QString, QVariant)));
+    context->GetApp()->AddObserver("test:direct");
+
+    observe("test:direct", "[1,2]");
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), QString("test:direct"));
+    QCOMPARE(spy.at(0).at(1).toList().size(), 2);
+    context->GetApp()->RemoveObserver("test:direct");
+}
+
+QTEST_MAIN(tst_Observers)
+
+#include "tst_observers.moc"
@@ -0,0 +1,7 @@
+include(../unit.pri)
+
+TARGET = tst_prefsfile
+
+SOURCES += tst_prefsfile.cpp \
+           $$SRC_DIR/prefsfile.cpp
+HEADERS += $$SRC_DIR/prefsfile.h
@@ -0,0 +1,79 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+
+#include "prefsfile.h"
+
+class tst_PrefsFile : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void values();
+    void escapes();
+    void keywordNeedsBoundary();
+    void malformedSkipped();
+
+private:
+    QVariantMap parse(const QByteArray& aData, int aExpected);
+};
+
+QVariantMap tst_PrefsFile::parse(const QByteArray& aData, int aExpected)
+{
+    QVariantMap prefs;
+    int count = PrefsFile::Parse(aData.constData(), aData.size(), prefs);
+    if (count != aExpected) {
+        qWarning("parsed %i prefs, expected %i", count, aExpected);
+    }
+    return prefs;
+}
+
+void tst_PrefsFile::values()
+{
+    QVariantMap prefs = parse("# comment\n"
+                              "user_pref(\"a.string\", \"text\");\n"
+                              "pref('a.int', -42); // trailing\n"
+                              "/* block\n comment */ sticky_pref(\"a.bool\", true);\n", 3);
+    QCOMPARE(prefs.value("a.string"), QVariant(QString("text")));
+    QCOMPARE(prefs.value("a.int"), QVariant(-42));
+    QCOMPARE(prefs.value("a.bool"), QVariant(true));
+}
+
+void tst_PrefsFile::escapes()
+{
+    QVariantMap prefs = parse("pref(\"a\", \"\\x41\\u00e9\\n\\\"\");\n"
+                              "pref(\"b\", \"\\ud83d\\ude00\");\n"
+                              "pref(\"c\", \"\\ud83dx\");\n", 3);
+    QCOMPARE(prefs.value("a").toString(), QString::fromUtf8("A\xc3\xa9\n\""));
+    // U+1F600 from its surrogate pair
+    QCOMPARE(prefs.value("b").toString(), QString::fromUtf8("\xf0\x9f\x98\x80"));
+    QCOMPARE(prefs.value("c").toString().right(1), QString("x"));
+}
+
+void tst_PrefsFile::keywordNeedsBoundary()
+{
+    QVariantMap prefs = parse("prefix(\"a\", 1);\n"
+                              "user_prefs(\"b\", 2);\n"
+                              "pref (\"c\", 3);\n", 1);
+    QVERIFY(!prefs.contains("a"));
+    QVERIFY(!prefs.contains("b"));
+    QCOMPARE(prefs.value("c"), QVariant(3));
+}
+
+void tst_PrefsFile::malformedSkipped()
+{
+    QVariantMap prefs = parse("pref(\"a\", );\n"
+                              "pref(\"b\", \"unterminated);\n"
+                              "pref(\"c\", 99999999999);\n"
+                              "pref(\"d\", false);\n", 1);
+    QCOMPARE(prefs.size(), 1);
+    QCOMPARE(prefs.value("d"), QVariant(false));
+}
+
+QTEST_MAIN(tst_PrefsFile)
+
+#include "tst_prefsfile.moc"
@@ -0,0 +1,7 @@
+include(../unit.pri)
+
+TARGET = tst_shmattachment
+
+SOURCES += tst_shmattachment.cpp \
+           $$SRC_DIR/shmattachment.cpp
+HEADERS += $$SRC_DIR/shmattachment.h
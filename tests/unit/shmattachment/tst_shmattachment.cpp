@@ -0,0 +1,72 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+#include <QFile>
+
+#include "shmattachment.h"
+
+class tst_ShmAttachment : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void descriptor();
+    void freedAfterBothSides();
+    void repeatedReleaseFromOneSide_data();
+    void repeatedReleaseFromOneSide();
+};
+
+void tst_ShmAttachment::descriptor()
+{
+    QByteArray data(4096, 'x');
+    ShmAttachment* attachment = ShmAttachment::Create(data);
+    QVERIFY(attachment);
+    QVariantMap descriptor = attachment->descriptor();
+    QCOMPARE(descriptor.value("size").toInt(), data.size());
+
+    QFile file(descriptor.value("path").toString());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), data);
+    file.close();
+
+    delete attachment;
+    QVERIFY(!QFile::exists(descriptor.value("path").toString()));
+}
+
+void tst_ShmAttachment::freedAfterBothSides()
+{
+    ShmAttachment* attachment = ShmAttachment::Create(QByteArray("data"));
+    QVERIFY(attachment);
+    QVERIFY(!attachment->release(ShmAttachment::Content));
+    QVERIFY(attachment->release(ShmAttachment::Sender));
+    delete attachment;
+}
+
+void tst_ShmAttachment::repeatedReleaseFromOneSide_data()
+{
+    QTest::addColumn<int>("side");
+    QTest::newRow("sender") << int(ShmAttachment::Sender);
+    QTest::newRow("content") << int(ShmAttachment::Content);
+}
+
+void tst_ShmAttachment::repeatedReleaseFromOneSide()
+{
+    QFETCH(int, side);
+    ShmAttachment* attachment = ShmAttachment::Create(QByteArray("data"));
+    QVERIFY(attachment);
+    // The other side may still be reading it
+    QVERIFY(!attachment->release(ShmAttachment::Side(side)));
+    QVERIFY(!attachment->release(ShmAttachment::Side(side)));
+    ShmAttachment::Side other = side == ShmAttachment::Sender ? ShmAttachment::Content
+                                                              : ShmAttachment::Sender;
+    QVERIFY(attachment->release(other));
+    delete attachment;
+}
+
+QTEST_MAIN(tst_ShmAttachment)
+
+#include "tst_shmattachment.moc"
@@ -0,0 +1,12 @@
+include(../unit.pri)
+
+TARGET = tst_snapshotqueue
+QT += opengl
+
+SOURCES += tst_snapshotqueue.cpp \
+           $$CONTEXT_SOURCES \
+           $$SRC_DIR/qmozheadlessview.cpp \
+           $$SRC_DIR/qmozsnapshotqueue.cpp
+HEADERS += $$CONTEXT_HEADERS \
+           $$SRC_DIR/qmozheadlessview.h \
+           $$SRC_DIR/qmozsnapshotqueue.h
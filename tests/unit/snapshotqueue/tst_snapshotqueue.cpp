@@ -0,0 +1,118 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+
+#include "qmozcontext.h"
+#include "qmozsnapshotqueue.h"
+#include "mozilla/embedlite/EmbedLiteApp.h"
+#include "mozilla/embedlite/EmbedInitGlue.h"
+
+using namespace mozilla::embedlite;
+
+class tst_SnapshotQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_SnapshotQueue() : mQueue(0), mGeckoView(0) {}
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void rendersInOrder();
+    void timeoutStopsAndMovesOn();
+
+private:
+    EmbedLiteApp* app() const { return XRE_GetEmbedLite(); }
+    EmbedLiteViewListener* gecko() const { return mGeckoView->GetListener(); }
+    // Gecko side of a page load, as the view sees it
+    void finishLoad(const char* aUrl);
+
+    QMozSnapshotQueue* mQueue;
+    EmbedLiteView* mGeckoView;
+};
+
+void tst_SnapshotQueue::initTestCase()
+{
+    QMozContext::GetInstance();
+    app()->GetListener()->Initialized();
+    QVERIFY(QMozContext::GetInstance()->initialized());
+}
+
+void tst_SnapshotQueue::init()
+{
+    mQueue = new QMozSnapshotQueue(1, QSize(320, 240));
+    QCoreApplication::processEvents();
+    mGeckoView = app()->mLastView;
+    QVERIFY(mGeckoView);
+}
+
+void tst_SnapshotQueue::cleanup()
+{
+    delete mQueue;
+    mQueue = 0;
+    mGeckoView = 0;
+}
+
+void tst_SnapshotQueue::finishLoad(const char* aUrl)
+{
+    gecko()->OnLoadStarted(aUrl);
+    gecko()->OnFirstPaint(0, 0);
+    gecko()->OnLoadFinished();
+}
+
+void tst_SnapshotQueue::rendersInOrder()
+{
+    QSignalSpy ready(mQueue, SIGNAL(snapshotReady(QString, QImage)));
+    QSignalSpy finished(mQueue, SIGNAL(finished()));
+    mQueue->enqueue(QStringList() << "http://example.com/a" << "http://example.com/b");
+    QCOMPARE(mQueue->pending(), 2);
+
+    gecko()->ViewInitialized();
+    QVERIFY(mGeckoView->mActive);
+    QCOMPARE(mGeckoView->mUrl, QByteArray("http://example.com/a"));
+    finishLoad("http://example.com/a");
+    QCOMPARE(ready.count(), 1);
+    QCOMPARE(ready.at(0).at(0).toString(), QString("http://example.com/a"));
+
+    QCOMPARE(mGeckoView->mUrl, QByteArray("http://example.com/b"));
+    finishLoad("http://example.com/b");
+    QCOMPARE(ready.count(), 2);
+    QCOMPARE(ready.at(1).at(0).toString(), QString("http://example.com/b"));
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(mQueue->pending(), 0);
+}
+
+void tst_SnapshotQueue::timeoutStopsAndMovesOn()
+{
+    QSignalSpy ready(mQueue, SIGNAL(snapshotReady(QString, QImage)));
+    QSignalSpy failed(mQueue, SIGNAL(snapshotFailed(QString)));
+    mQueue->setTimeout(50);
+    gecko()->ViewInitialized();
+    mQueue->enqueue(QStringList() << "http://example.com/slow" << "http://example.com/b");
+    gecko()->OnLoadStarted("http://example.com/slow");
+
+    QTRY_COMPARE(failed.count(), 1);
+    QCOMPARE(failed.at(0).at(0).toString(), QString("http://example.com/slow"));
+    QCOMPARE(mGeckoView->mStops, 1);
+    QCOMPARE(mGeckoView->mUrl, QByteArray("http://example.com/b"));
+
+    // The stopped page still paints and finishes, it must not be taken
+    // for the next URL
+    gecko()->OnFirstPaint(0, 0);
+    gecko()->OnLoadFinished();
+    QCOMPARE(ready.count(), 0);
+
+    finishLoad("http://example.com/b");
+    QCOMPARE(ready.count(), 1);
+    QCOMPARE(ready.at(0).at(0).toString(), QString("http://example.com/b"));
+}
+
+QTEST_MAIN(tst_SnapshotQueue)
+
+#include "tst_snapshotqueue.moc"
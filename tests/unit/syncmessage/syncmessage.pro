@@ -0,0 +1,8 @@
+include(../unit.pri)
+
+TARGET = tst_syncmessage
+QT += opengl
+
+SOURCES += tst_syncmessage.cpp \
+           $$VIEW_SOURCES
+HEADERS += $$VIEW_HEADERS
@@ -0,0 +1,137 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+#include <QPointer>
+#include <stdlib.h>
+
+#include "qgraphicsmozview.h"
+#include "messagecodec.h"
+#include "viewtest.h"
+#include "mozilla/embedlite/EmbedLiteView.h"
+
+class tst_SyncMessage : public ViewTest
+{
+    Q_OBJECT
+
+public:
+    tst_SyncMessage() : mDefer(false) {}
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void immediateReply();
+    void deferredReplyArrivesLater();
+    void deferredReplyTimesOut();
+
+    void onSyncMessage(const QString message, const QVariant data, QSyncMessageResponse* response);
+
+private:
+    // What content's sendSyncMessage() returns
+    QVariant send(const QString& aName, const QString& aJson);
+    QVariant decode(const QString& aJson) const;
+
+    bool mDefer;
+    QPointer<QSyncMessageResponse> mResponse;
+};
+
+void tst_SyncMessage::initTestCase()
+{
+    QVERIFY(initContext());
+}
+
+void tst_SyncMessage::init()
+{
+    QVERIFY(createView());
+    mGeckoView->mRecordSent = true;
+    connect(mView, SIGNAL(recvSyncMessage(QString, QVariant, QSyncMessageResponse*)),
+            this, SLOT(onSyncMessage(QString, QVariant, QSyncMessageResponse*)));
+    mDefer = false;
+}
+
+void tst_SyncMessage::cleanup()
+{
+    destroyView();
+}
+
+void tst_SyncMessage::onSyncMessage(const QString message, const QVariant data, QSyncMessageResponse* response)
+{
+    Q_UNUSED(message);
+    mResponse = response;
+    if (mDefer) {
+        response->defer(50, QString("default"));
+    } else {
+        response->setMessage(data);
+    }
+}
+
+QVariant tst_SyncMessage::decode(const QString& aJson) const
+{
+    bool ok = false;
+    QVariant result = MessageCodec::DecodeJson(aJson.constData(), aJson.size(), &ok);
+    return ok ? result : QVariant();
+}
+
+QVariant tst_SyncMessage::send(const QString& aName, const QString& aJson)
+{
+    char* reply = mGeckoView->GetListener()->RecvSyncMessage((const PRUnichar*)aName.utf16(),
+                                                             (const PRUnichar*)aJson.utf16());
+    QVariant result = decode(QString::fromUtf8(reply));
+    free(reply);
+    return result;
+}
+
+void tst_SyncMessage::immediateReply()
+{
+    QVariantMap data;
+    data.insert("x", 1);
+    QCOMPARE(send("test:sync", "{\"x\":1}").toMap(), data);
+    QVERIFY(mGeckoView->mSentNames.isEmpty());
+}
+
+void tst_SyncMessage::deferredReplyArrivesLater()
+{
+    mDefer = true;
+    QVariantMap ticket = send("test:sync", "null").toMap();
+    // Returned without waiting, no reply went out yet
+    QVERIFY(ticket.contains("embed:deferred"));
+    QVERIFY(mGeckoView->mSentNames.isEmpty());
+    QVERIFY(mResponse);
+
+    mResponse->complete(QString("done"));
+    QCOMPARE(mGeckoView->mSentNames, QStringList() << "embed:sync-reply");
+    QVariantMap reply = decode(mGeckoView->mSentData.first()).toMap();
+    QCOMPARE(reply.value("id").toUInt(), ticket.value("embed:deferred").toUInt());
+    QCOMPARE(reply.value("data").toString(), QString("done"));
+
+    // Owned by the view and released once answered
+    QTRY_VERIFY(!mResponse);
+}
+
+void tst_SyncMessage::deferredReplyTimesOut()
+{
+    mDefer = true;
+    QVariantMap ticket = send("test:sync", "null").toMap();
+    QVERIFY(ticket.contains("embed:deferred"));
+
+    QTRY_COMPARE(mGeckoView->mSentNames, QStringList() << "embed:sync-reply");
+    QVariantMap reply = decode(mGeckoView->mSentData.first()).toMap();
+    QCOMPARE(reply.value("data").toString(), QString("default"));
+    QVariantMap stats = mView->syncMessageStatistics().value("test:sync").toMap();
+    QCOMPARE(stats.value("timeouts").toInt(), 1);
+
+    // Completing late sends nothing more
+    if (mResponse) {
+        mResponse->complete(QString("late"));
+    }
+    QCOMPARE(mGeckoView->mSentNames.size(), 1);
+    QTRY_VERIFY(!mResponse);
+}
+
+QTEST_MAIN(tst_SyncMessage)
+
+#include "tst_syncmessage.moc"
@@ -0,0 +1,7 @@
+include(../unit.pri)
+
+TARGET = tst_threadpolicy
+
+SOURCES += tst_threadpolicy.cpp \
+           $$SRC_DIR/geckothreadpolicy.cpp
+HEADERS += $$SRC_DIR/geckothreadpolicy.h
@@ -0,0 +1,124 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+#include <errno.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "geckothreadpolicy.h"
+
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+#define SKIP(aMessage) QSKIP(aMessage, SkipSingle)
+#else
+#define SKIP(aMessage) QSKIP(aMessage)
+#endif
+
+// The test thread stands in for the Gecko thread
+class tst_ThreadPolicy : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void invalidNiceIsRejected();
+    void droppedNiceIsRestored();
+    void emptyAffinityIsRestored();
+
+private:
+    static pid_t tid() { return syscall(SYS_gettid); }
+    static int nice() { return getpriority(PRIO_PROCESS, tid()); }
+    static quint64 affinity();
+
+    GeckoThreadPolicy* mPolicy;
+};
+
+quint64 tst_ThreadPolicy::affinity()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(tid(), sizeof(set), &set);
+    quint64 mask = 0;
+    for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            mask |= Q_UINT64_C(1) << cpu;
+        }
+    }
+    return mask;
+}
+
+void tst_ThreadPolicy::init()
+{
+    mPolicy = new GeckoThreadPolicy();
+    mPolicy->attachCurrentThread();
+}
+
+void tst_ThreadPolicy::cleanup()
+{
+    mPolicy->detachThread();
+    delete mPolicy;
+    mPolicy = 0;
+}
+
+void tst_ThreadPolicy::invalidNiceIsRejected()
+{
+    QVariantMap policy;
+    policy.insert("nice", 5);
+    QVERIFY(mPolicy->update(policy));
+    policy.insert("nice", "lower");
+    QVERIFY(!mPolicy->update(policy));
+    QCOMPARE(mPolicy->toVariantMap().value("nice").toInt(), 5);
+}
+
+void tst_ThreadPolicy::droppedNiceIsRestored()
+{
+    int inherited = nice();
+    if (inherited >= 19) {
+        SKIP("Already at the highest nice value");
+    }
+    QVariantMap policy;
+    policy.insert("nice", inherited + 1);
+    QVERIFY(mPolicy->update(policy));
+    QVERIFY(mPolicy->apply());
+    QCOMPARE(nice(), inherited + 1);
+
+    policy.insert("nice", QVariant());
+    QVERIFY(mPolicy->update(policy));
+    QVERIFY(!mPolicy->toVariantMap().contains("nice"));
+    if (!mPolicy->apply()) {
+        SKIP("Lowering the nice value needs CAP_SYS_NICE or RLIMIT_NICE");
+    }
+    QCOMPARE(nice(), inherited);
+}
+
+void tst_ThreadPolicy::emptyAffinityIsRestored()
+{
+    quint64 inherited = affinity();
+    if (!inherited) {
+        SKIP("No CPU below 64 available");
+    }
+    int first = 0;
+    while (!(inherited & (Q_UINT64_C(1) << first))) {
+        ++first;
+    }
+    QVariantMap policy;
+    policy.insert("affinity", QVariantList() << first);
+    QVERIFY(mPolicy->update(policy));
+    QVERIFY(mPolicy->apply());
+    QCOMPARE(affinity(), Q_UINT64_C(1) << first);
+
+    policy.insert("affinity", QVariantList());
+    QVERIFY(mPolicy->update(policy));
+    QVERIFY(mPolicy->apply());
+    QCOMPARE(affinity(), inherited);
+}
+
+QTEST_MAIN(tst_ThreadPolicy)
+
+#include "tst_threadpolicy.moc"
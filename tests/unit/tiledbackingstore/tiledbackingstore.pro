@@ -0,0 +1,7 @@
+include(../unit.pri)
+
+TARGET = tst_tiledbackingstore
+
+SOURCES += tst_tiledbackingstore.cpp \
+           $$SRC_DIR/tiledbackingstore.cpp
+HEADERS += $$SRC_DIR/tiledbackingstore.h
@@ -0,0 +1,118 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* vim: set ts=4 sw=4 et tw=79: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <QtTest/QtTest>
+#include <QPainter>
+
+#include "tiledbackingstore.h"
+
+static const QSize kViewSize(200, 300);
+
+// Whole page, every pixel distinct enough to catch misplaced tiles
+static QImage page()
+{
+    QImage image(1024, 2048, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            line[x] = qRgb(x & 0xff, y & 0xff, (x >> 8) + ((y >> 8) << 2));
+        }
+    }
+    return image;
+}
+
+// What Gecko renders with the view scrolled to aOffset
+static QImage frameAt(const QImage& aPage, const QPoint& aOffset)
+{
+    return aPage.copy(QRect(aOffset, kViewSize));
+}
+
+// Same, with a position:fixed bar on top of the viewport
+static QImage frameWithFixedBar(const QImage& aPage, const QPoint& aOffset)
+{
+    QImage frame = frameAt(aPage, aOffset);
+    QPainter p(&frame);
+    p.fillRect(QRect(0, 0, kViewSize.width(), 40), Qt::red);
+    return frame;
+}
+
+class tst_TiledBackingStore : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void disabledByDefault();
+    void composesScrolledFrame();
+    void missesUncachedContent();
+    void detectsFixedContent();
+    void evictsLeastRecentlyUsed();
+};
+
+void tst_TiledBackingStore::disabledByDefault()
+{
+    TiledBackingStore tiles;
+    QVERIFY(!tiles.isEnabled());
+    tiles.update(frameAt(page(), QPoint(0, 0)), QPoint(0, 0));
+    QVERIFY(!tiles.covers(QRect(QPoint(0, 0), kViewSize)));
+}
+
+void tst_TiledBackingStore::composesScrolledFrame()
+{
+    QImage content = page();
+    TiledBackingStore tiles;
+    tiles.setMaxBytes(16 * 1024 * 1024);
+    tiles.update(frameAt(content, QPoint(0, 0)), QPoint(0, 0));
+    tiles.update(frameAt(content, QPoint(0, 300)), QPoint(0, 300));
+
+    QPoint scrolled(0, 170);
+    QVERIFY(tiles.covers(QRect(scrolled, kViewSize)));
+    QImage composed(kViewSize, QImage::Format_RGB32);
+    tiles.paint(composed, scrolled, Qt::black);
+    QCOMPARE(composed, frameAt(content, scrolled));
+    QVERIFY(tiles.matches(frameAt(content, scrolled), scrolled));
+}
+
+void tst_TiledBackingStore::missesUncachedContent()
+{
+    QImage content = page();
+    TiledBackingStore tiles;
+    tiles.setMaxBytes(16 * 1024 * 1024);
+    tiles.update(frameAt(content, QPoint(0, 0)), QPoint(0, 0));
+
+    QVERIFY(!tiles.covers(QRect(QPoint(0, 100), kViewSize)));
+    QVERIFY(tiles.misses() > 0);
+}
+
+void tst_TiledBackingStore::detectsFixedContent()
+{
+    QImage content = page();
+    TiledBackingStore tiles;
+    tiles.setMaxBytes(16 * 1024 * 1024);
+    tiles.update(frameWithFixedBar(content, QPoint(0, 0)), QPoint(0, 0));
+
+    // The bar stays put while the page moves under it, so the cached
+    // copy of it is in the wrong place for any other offset
+    QPoint scrolled(0, 20);
+    QVERIFY(!tiles.matches(frameWithFixedBar(content, scrolled), scrolled));
+    QVERIFY(tiles.matches(frameWithFixedBar(content, QPoint(0, 0)), QPoint(0, 0)));
+}
+
+void tst_TiledBackingStore::evictsLeastRecentlyUsed()
+{
+    QImage content = page();
+    TiledBackingStore tiles;
+    // Room for one 200x300 frame at tile aligned offsets, two 256x256 tiles
+    tiles.setMaxBytes(2 * 256 * 256 * 4);
+    tiles.update(frameAt(content, QPoint(0, 0)), QPoint(0, 0));
+    tiles.update(frameAt(content, QPoint(512, 1024)), QPoint(512, 1024));
+
+    QVERIFY(tiles.covers(QRect(QPoint(512, 1024), kViewSize)));
+    QVERIFY(!tiles.covers(QRect(QPoint(0, 0), kViewSize)));
+}
+
+QTEST_MAIN(tst_TiledBackingStore)
+
+#include "tst_tiledbackingstore.moc"
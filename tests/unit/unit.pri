@@ -0,0 +1,52 @@
+# Unit tests build the library sources they exercise against the stand-in
+# Gecko headers in tests/stubs
+TEMPLATE = app
+CONFIG += warn_on
+QT += testlib
+
+SRC_DIR = ../../../src
+STUBS_DIR = ../../stubs
+COMMON_DIR = ../common
+INCLUDEPATH += $$STUBS_DIR $$SRC_DIR $$COMMON_DIR
+DEFINES += BUILD_GRE_HOME=\"\\\"/tmp\\\"\"
+unix:QMAKE_CXXFLAGS += -std=c++0x
+unix:LIBS += -lrt
+
+# What QMozContext needs, for tests driving views through the stub app
+CONTEXT_SOURCES = $$STUBS_DIR/stubs.cpp \
+                  $$SRC_DIR/qmozcontext.cpp \
+                  $$SRC_DIR/geckoworker.cpp \
+                  $$SRC_DIR/geckothreadpolicy.cpp \
+                  $$SRC_DIR/framescheduler.cpp \
+                  $$SRC_DIR/viewpool.cpp \
+                  $$SRC_DIR/prefsfile.cpp \
+                  $$SRC_DIR/messagecodec.cpp
+CONTEXT_HEADERS = $$SRC_DIR/qmozcontext.h \
+                  $$SRC_DIR/geckoworker.h \
+                  $$SRC_DIR/geckothreadpolicy.h \
+                  $$SRC_DIR/framescheduler.h \
+                  $$SRC_DIR/viewpool.h
+
+# QGraphicsMozView on top of that, with the shared ViewTest fixture
+VIEW_SOURCES = $$CONTEXT_SOURCES \
+               $$COMMON_DIR/viewtest.cpp \
+               $$SRC_DIR/qgraphicsmozview.cpp \
+               $$SRC_DIR/qgraphicsmozview_p.cpp \
+               $$SRC_DIR/renderworker.cpp \
+               $$SRC_DIR/shmbackbuffer.cpp \
+               $$SRC_DIR/tiledbackingstore.cpp \
+               $$SRC_DIR/latencyhistogram.cpp \
+               $$SRC_DIR/shmattachment.cpp
+VIEW_HEADERS = $$CONTEXT_HEADERS \
+               $$COMMON_DIR/viewtest.h \
+               $$SRC_DIR/qgraphicsmozview.h \
+               $$SRC_DIR/renderworker.h
+
+contains(QT_MAJOR_VERSION, 4) {
+  CONFIG += link_pkgconfig
+  PKGCONFIG += QJson
+  x11:LIBS += -lXext
+}
+
+target.path = /opt/tests/qtmozembed/unit
+INSTALLS += target
@@ -0,0 +1,5 @@
+TEMPLATE = subdirs
+
+SUBDIRS = framescheduler tiledbackingstore headlessview snapshotqueue messagepayload messagebatching syncmessage messagehandlers observers shmattachment messagelanes prefsfile
+# Restoring inherited settings is only implemented on Linux
+linux:SUBDIRS += threadpolicy